@@ -1,57 +1,11 @@
-// Most copied from LLVM's official tutorials about building Kaleidoscope language
-
-//#include "llvm/ADT/APFloat.h"
-#include "llvm/ADT/STLExtras.h"
-#include "llvm/IR/BasicBlock.h"
-#include "llvm/IR/Constants.h"
-#include "llvm/IR/DerivedTypes.h"
-#include "llvm/IR/Function.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/LLVMContext.h"
-#include "llvm/IR/Module.h"
-#include "llvm/IR/Type.h"
-#include "llvm/IR/Verifier.h"
-#include <cctype>
-#include <cstdio>
-#include <cstdlib>
-#include <map>
-#include <memory>
-#include <string>
-#include <vector>
 #include "ast.h"
+#include <climits>
 #include <iostream>
+#include <iterator>
+#include <unordered_map>
 
-using namespace llvm;
 using namespace mila;
 
-namespace mila
-{
-    LLVMContext TheContext;
-    std::unique_ptr<Module> TheModule ( make_unique<Module>("mila",TheContext) );
-    IRBuilder<> Builder = IRBuilder<> ( TheContext );
-    std::map<std::string, Value *> NamedValues;
-    std::map<std::string, Value *> ConstValues;
-    std::map<std::string, std::unique_ptr<PrototypeAST>> FunctionProtos;
-    std::map<std::string, Function *> Library
-    {
-        std::make_pair ( "readln",
-                cast<Function>(TheModule->getOrInsertFunction("readln",IntegerType::getInt32Ty(TheModule->getContext()),PointerType::getUnqual(IntegerType::getInt32Ty(TheModule->getContext()))))),
-            std::make_pair ( "inc",
-                    cast<Function>(TheModule->getOrInsertFunction("inc",IntegerType::getInt32Ty(TheModule->getContext()),PointerType::getUnqual(IntegerType::getInt32Ty(TheModule->getContext()))))),
-            std::make_pair ( "dec",
-                    cast<Function>(TheModule->getOrInsertFunction("dec",IntegerType::getInt32Ty(TheModule->getContext()),PointerType::getUnqual(IntegerType::getInt32Ty(TheModule->getContext())))))
-    };
-
-// Create main function
-Function *main_func = cast<Function>(TheModule->
-    getOrInsertFunction("main", IntegerType::getInt32Ty(TheModule->getContext()),
-                  NULL));
-    
-// Create basic block and start inserting into it
-BasicBlock *mainBlock = BasicBlock::Create(TheModule->getContext(), "main.0", main_func);
-};
-
 int mila::getPrecedence ( OperEnum op )
 {
     switch (op)
@@ -82,661 +36,615 @@ int mila::getPrecedence ( OperEnum op )
 }
 
 //===----------------------------------------------------------------------===//
-// Code Generation
+// Node table
 //===----------------------------------------------------------------------===//
 
-/// LogError* - These are little helper functions for error handling.
-/*
-   std::unique_ptr<ExprAST> LogError(const char *Str) {
-   fprintf(stderr, "Error: %s\n", Str);
-   return nullptr;
-   }
-
-   std::unique_ptr<PrototypeAST> LogErrorP(const char *Str) {
-   LogError(Str);
-   return nullptr;
-   }
-   */
-
-
-/*
-   Value *LogErrorV(const char *Str) {
-   LogError(Str);
-   return nullptr;
-   }
-   */
-
-Value * mila::NumberExprAST::codegen() 
+NodeId mila::Ast::add ( NodeKind kind, std::uint32_t head, const NodeId * first, const NodeId * last, OperEnum op )
 {
-    return ConstantInt::get(TheContext, APInt(32, Val, true));
+    kinds . push_back ( kind );
+    ops . push_back ( op );
+    heads . push_back ( head );
+    firsts . push_back ( children . size () );
+    counts . push_back ( last - first );
+    slots . push_back ( NO_SLOT );
+    children . insert ( children . end (), first, last );
+    return kinds . size () - 1;
 }
 
-Value * mila::ExprListAST::codegen()
+NodeId mila::Ast::add ( NodeKind kind, std::uint32_t head, std::initializer_list < NodeId > children )
 {
-    for (auto &expr : Nodes)
-        if(expr)
-            if(!expr->codegen())
-                return nullptr;
-     return Constant::getNullValue(Type::getInt32Ty(TheContext));
-}
-
-Value * mila::ConstExprAST::codegen()
-{
-    Value * alloca = ConstValues[Name];
-    if (alloca)
-        throw ("Constant redeclaration");
-    alloca = Builder.CreateAlloca(Type::getInt32Ty(TheContext));
-    Builder.CreateStore(ConstantInt::get(TheContext, APInt(32, Val, true)), alloca);
-    ConstValues[Name] = alloca;
-    return alloca;
+    return add ( kind, head, children . begin (), children . end () );
 }
 
-Value * mila::DeclareExprAST::codegen()
+NodeId mila::Ast::binary ( OperEnum op, NodeId lhs, NodeId rhs )
 {
-    std::string sugar = Name + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    Value * alloca = NamedValues[sugar];
-    if (alloca)
-        throw ("Variable redeclaration.");
-
-    if (Length)
-    {
-        alloca = Builder.CreateAlloca(Type::getInt32Ty(TheContext),
-                                    ConstantInt::get(TheContext, APInt(32, Length, true)));
-        alloca = Builder.CreateGEP(Type::getInt32Ty(TheContext), alloca, ConstantInt::get(TheContext, APInt(32, Offset, true)));
-    }
-    else
-        alloca = Builder.CreateAlloca(Type::getInt32Ty(TheContext));
-    NamedValues[sugar] = alloca;
-    return alloca;
+    NodeId operands [] = { lhs, rhs };
+    return add ( NODE_BINARY, 0, operands, operands + 2, op );
 }
 
-Value * mila::VariableExprAST::codegen() 
+NodeId mila::Ast::number ( int value )
 {
-    std::string sugar = Name + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    // Look this variable up in the function.
-    Value *V = NamedValues[sugar];
-    if (!V)
-        V = ConstValues[Name];
-    if (!V)
-        throw ("Unknown constant/variable name");
-    return Builder.CreateLoad(V, Name.c_str());
+    literals . push_back ( value );
+    return add ( NODE_NUMBER, literals . size () - 1 );
 }
 
-Value * mila::ArrayExprAST::codegen()
+void mila::Ast::direct ( NodeId node, const Directives & directives )
 {
-    std::string sugar = Name + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    Value *V = NamedValues[sugar];
-    if (!V)
-        throw ("Unknown array name");
-    auto ptr = Builder.CreateGEP(Type::getInt32Ty(TheContext), V, Index->codegen());
-    return Builder.CreateLoad(ptr);
-}
-
-Value *BinaryExprAST::codegen() {
-  // Special case '=' because we don't want to emit the LHS as an expression.
-  if (Op == ASSIGN) {
-    // Assignment requires the LHS to be an identifier.
-    // This assume we're building without RTTI because LLVM builds that way by
-    // default.  If you build LLVM with RTTI this can be changed to a
-    // dynamic_cast for automatic error checking.
-    VariableExprAST *LHSE = static_cast<VariableExprAST *>(LHS.get());
-    if (!LHSE)
-      throw("destination of '=' must be a variable");
-    // Codegen the RHS.
-    Value *Val = RHS->codegen();
-    if (!Val)
-      return nullptr;
-
-    // Look up the name.
-    //Value *Variable = NamedValues[LHSE->getName()];
-    Value *Variable = LHSE->alloca();
-    if (!Variable)
-      throw("Unknown variable name");
-
-    Builder.CreateStore(Val, Variable);
-    return Val;
-  }
-
-  Value *L = LHS->codegen();
-  Value *R = RHS->codegen();
-  if (!L || !R)
-    return nullptr;
-
-  switch (Op) {
-  case ADD:
-    return Builder.CreateAdd(L, R, "addtmp");
-  case SUB:
-    return Builder.CreateSub(L, R, "subtmp");
-  case MULT:
-    return Builder.CreateMul(L, R, "multmp");
-  case DIV:
-    return Builder.CreateSDiv(L, R, "divtmp");
-  case MOD:
-    return Builder.CreateSRem(L, R, "modtmp");
-  case LT:
-    L = Builder.CreateICmpSLT(L, R, "lttmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case LE:
-    L = Builder.CreateICmpSLE(L, R, "letmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case GT:
-    L = Builder.CreateICmpSGT(L, R, "gttmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case GE:
-    L = Builder.CreateICmpSGE(L, R, "getmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case EQ:
-    L = Builder.CreateICmpEQ(L, R, "eqtmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case NE:
-    L = Builder.CreateICmpNE(L, R, "netmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case AND:
-    L = Builder.CreateICmpNE(
-                L, ConstantInt::get(TheContext, APInt(32, 0, true)), "booltmp");
-    R = Builder.CreateICmpNE(
-                R, ConstantInt::get(TheContext, APInt(32, 0, true)), "booltmp");
-    L = Builder.CreateAnd(L, R, "andtmp");
-    return Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp");
-  case OR:
-    return Builder.CreateOr(L, R, "ortmp");
-  default:
-    throw ("Unknown operator");
-    break;
-  }
-
-  return nullptr;
+    directed [ node ] = directives;
 }
 
-Value * mila::CallExprAST::codegen() 
+NodeId mila::Ast::append ( const Ast & other )
 {
-    // Look up the name in the global module table.
-    Function *CalleeF = TheModule->getFunction(Callee);
-    if (!CalleeF)
-        throw ("Unknown function referenced");
-
-    // If argument mismatch error.
-    if (CalleeF->arg_size() != Args.size())
-        throw ("Incorrect # arguments passed");
-
-    std::vector<Value *> ArgsV;
-    for (unsigned i = 0, e = Args.size(); i != e; ++i) 
+    NodeId base = size ();
+    std::uint32_t childBase = children . size ();
+    std::uint32_t literalBase = literals . size ();
+    kinds . insert ( kinds . end (), other . kinds . begin (), other . kinds . end () );
+    ops . insert ( ops . end (), other . ops . begin (), other . ops . end () );
+    for ( NodeId node = 0 ; node < other . size () ; node ++ )
     {
-        ArgsV.push_back(Args[i]->codegen());
-        if (!ArgsV.back())
-            return nullptr;
+        heads . push_back ( other . kinds [ node ] == NODE_NUMBER ? other . heads [ node ] + literalBase : other . heads [ node ] );
+        firsts . push_back ( other . firsts [ node ] + childBase );
     }
-
-    return Builder.CreateCall(CalleeF, ArgsV, "calltmp");
+    counts . insert ( counts . end (), other . counts . begin (), other . counts . end () );
+    slots . insert ( slots . end (), other . slots . begin (), other . slots . end () );
+    for ( NodeId child : other . children )
+        children . push_back ( child + base );
+    literals . insert ( literals . end (), other . literals . begin (), other . literals . end () );
+    for ( const auto & entry : other . directed )
+        directed [ entry . first + base ] = entry . second;
+    return base;
 }
 
-Value * mila::LibraryExprAST::codegen()
+void mila::Ast::clear ( void )
 {
-    std::string sugar = Arg + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    auto ptr = NamedValues [sugar];
-    if (!ptr)
-        return nullptr;
-    auto func = Library [Name];
-    return Builder.CreateCall(func, ptr);
+    kinds . clear ();
+    ops . clear ();
+    heads . clear ();
+    firsts . clear ();
+    counts . clear ();
+    children . clear ();
+    literals . clear ();
+    slots . clear ();
+    directed . clear ();
+    slotCnt = 0;
 }
 
-Function * mila::PrototypeAST::codegen() 
+bool mila::Ast::operator == ( const Ast & other ) const
 {
-    // Make the function type:  double(double,double) etc.
-    std::vector<Type *> Ints(Args.size(), Type::getInt32Ty(TheContext));
-    FunctionType *FT =
-        FunctionType::get(Type::getInt32Ty(TheContext), Ints, false);
-
-    Function *F =
-        Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
-
-    // Set names for all arguments.
-    unsigned Idx = 0;
-    for (auto &Arg : F->args())
-        Arg.setName(Args[Idx++]);
-
-    return F;
+    return kinds == other . kinds && ops == other . ops && heads == other . heads && firsts == other . firsts
+        && counts == other . counts && children == other . children && literals == other . literals
+        && slots == other . slots && directed == other . directed;
 }
 
-Function * mila::FunctionAST::codegen() 
+std::size_t mila::Ast::bytes ( void ) const
 {
-    // First, check for an existing function from a previous 'extern' declaration.
-    Function *TheFunction = TheModule->getFunction(Proto->getName());
-
-    if (!TheFunction)
-        TheFunction = Proto->codegen();
-
-    if (!TheFunction)
-        return nullptr;
-
-    // Create a new basic block to start insertion into.
-    BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
-    Builder.SetInsertPoint(BB);
-
-    // Record the function arguments in the NamedValues map.
-    //NamedValues.clear();
-    for (auto &Arg : TheFunction->args())
-    {
-        // Create an alloca for this variable.
-        Value *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName());
-
-        // Store the initial value int o the alloca.
-        Builder.CreateStore(&Arg, Alloca);
-
-        // Add arguments to variable symbol table.
-        std::string sugar = Arg.getName().str() + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-        NamedValues[sugar] = Alloca;
-    }
-    
-    BasicBlock *Ret = BasicBlock::Create(TheContext, "return", TheFunction);
-
-    for (unsigned i = 0 ; i < Body.size() ; i++)
-    {
-        if (i != Body.size() - 1)
-            Body[i]->codegen();
-        else if (Value *RetVal = Body[i]->codegen()) 
-        {
-            Builder.CreateBr(Ret);
-            // Finish off the function.
-            Builder.SetInsertPoint(Ret);
-            Builder.CreateRet(RetVal);
-
-            // Validate the generated code, checking for consistency.
-            verifyFunction(*TheFunction);
-
-            Builder.SetInsertPoint(mainBlock);
-            return TheFunction;
-        }
-        else break;
-    }
-
-    // Error reading body, remove function.
-    TheFunction->eraseFromParent();
-    return nullptr;
-}
-
-Value * mila::ReturnExprAST::codegen()
-{
-    Function *TheFunction = TheModule->getFunction(Builder.GetInsertPoint()->getParent()->getName());
-    std::string sugar = TheFunction->getName().str() + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    Value *Alloca = NamedValues[sugar];
-    Value *Ret;
-    if (Alloca)
-        Ret = Builder.CreateLoad(Alloca);
-    else
-        Ret = ConstantInt::get(TheContext, APInt(32, 0, true));
-    Builder.CreateRet(Ret);
-    BasicBlock *Cont = BasicBlock::Create(TheContext, "dunno", TheFunction);
-    Builder.SetInsertPoint(Cont);
-    return ConstantInt::get(TheContext, APInt(32, 0, true));
+    return kinds . capacity () * sizeof ( NodeKind ) + ops . capacity () + heads . capacity () * sizeof ( std::uint32_t )
+        + firsts . capacity () * sizeof ( std::uint32_t ) + counts . capacity () * sizeof ( std::uint32_t )
+        + children . capacity () * sizeof ( NodeId ) + literals . capacity () * sizeof ( int )
+        + slots . capacity () * sizeof ( std::uint32_t )
+        + directed . bucket_count () * sizeof ( void * ) + directed . size () * ( sizeof ( void * ) + sizeof ( NodeId ) + sizeof ( Directives ) );
 }
 
-// Output for-loop as:
-//   var = alloca double
-//   ...
-//   start = startexpr
-//   store start -> var
-//   goto loop
-// loop:
-//   ...
-//   bodyexpr
-//   ...
-// loopend:
-//   step = stepexpr
-//   endcond = endexpr
-//
-//   curvar = load var
-//   nextvar = curvar + step
-//   store nextvar -> var
-//   br endcond, loop, endloop
-// outloop:
-Value * mila::ForExprAST::codegen() {
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-
-  // Create an alloca for the variable in the entry block.
-  //Value *Alloca = CreateEntryBlockAlloca(TheFunction, VarName);
-    std::string sugar = VarName + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-  Value *Alloca = NamedValues [sugar];
-  if (!Alloca)
-      throw ("Unknown variable name in for cycle");
-
-  // Emit the start code first, without 'variable' in scope.
-  Value *StartVal = Start->codegen();
-  if (!StartVal)
-    return nullptr;
-
-  // Store the value into the alloca.
-  Builder.CreateStore(StartVal, Alloca);
-
-  // Make the new basic block for the loop header, inserting after current
-  // block.
-  BasicBlock *LoopBB = BasicBlock::Create(TheContext, "loop", TheFunction);
-
-  // Insert an explicit fall through from the current block to the LoopBB.
-  Builder.CreateBr(LoopBB);
-
-  // Start insertion in LoopBB.
-  Builder.SetInsertPoint(LoopBB);
-
-  // Within the loop, the variable is defined equal to the PHI node.  If it
-  // shadows an existing variable, we have to restore it, so save it now.
-  Value *OldVal = NamedValues[sugar];
-  NamedValues[sugar] = Alloca;
-
-  // Emit the body of the loop.  This, like any other expr, can change the
-  // current BB.  Note that we ignore the value computed by the body, but don't
-  // allow an error.
-  if (!Body->codegen())
-    return nullptr;
-
-  // Emit the step value.
-  Value *StepVal = nullptr;
-  if (Step) {
-    StepVal = Step->codegen();
-    if (!StepVal)
-      return nullptr;
-  } else {
-    // If not specified, use 1.0.
-    StepVal = ConstantInt::get(TheContext, APInt(32, 1, true));
-  }
-
-  // Compute the end condition.
-  Value *EndCond = Builder.CreateIntCast (
-                           Builder.CreateICmpEQ(End->codegen(),
-                                                Builder.CreateLoad(Alloca, "endforload"),
-                                                "endfor"),
-                           Type::getInt32Ty(TheContext),
-                           false,
-                           "endforcast");
-  if (!EndCond)
-    return nullptr;
-
-  // Reload, increment, and restore the alloca.  This handles the case where
-  // the body of the loop mutates the variable.
-  Value *CurVar = Builder.CreateLoad(Alloca, VarName.c_str());
-  Value *NextVar = Builder.CreateFAdd(CurVar, StepVal, "nextvar");
-  Builder.CreateStore(NextVar, Alloca);
-
-  // Convert condition to a bool by comparing non-equal to 0.0.
-  EndCond = Builder.CreateICmpNE(
-      EndCond, ConstantInt::get(TheContext, APInt(32, 1, true)), "loopcond");
-
-  // Create the "after loop" block and insert it.
-  BasicBlock *AfterBB =
-      BasicBlock::Create(TheContext, "afterloop", TheFunction);
-
-  // Insert the conditional branch into the end of LoopEndBB.
-  Builder.CreateCondBr(EndCond, LoopBB, AfterBB);
-
-  // Any new code will be inserted in AfterBB.
-  Builder.SetInsertPoint(AfterBB);
-
-  // Restore the unshadowed variable.
-  if (OldVal)
-    NamedValues[sugar] = OldVal;
-  else
-    NamedValues.erase(sugar);
-
-  // for expr always returns 0.0.
-  return Constant::getNullValue(Type::getInt32Ty(TheContext));
-}
-
-Value * mila::IfExprAST::codegen() {
-  Value *CondV = Cond->codegen();
-  if (!CondV)
-    return nullptr;
-
-  // Convert condition to a bool by comparing non-equal to 0.0.
-  CondV = Builder.CreateICmpNE(
-      CondV, ConstantInt::get(TheContext, APInt(32, 0, true)), "ifcond");
-
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-
-  // Create blocks for the then and else cases.  Insert the 'then' block at the
-  // end of the function.
-  BasicBlock *ThenBB = BasicBlock::Create(TheContext, "then", TheFunction);
-  BasicBlock *ElseBB = BasicBlock::Create(TheContext, "else");
-  BasicBlock *MergeBB = BasicBlock::Create(TheContext, "ifcont");
-
-  Builder.CreateCondBr(CondV, ThenBB, ElseBB);
-
-  // Emit then value.
-  Builder.SetInsertPoint(ThenBB);
-
-  Value *ThenV = Then->codegen();
-  if (!ThenV)
-    return nullptr;
-
-  Builder.CreateBr(MergeBB);
-  // Codegen of 'Then' can change the current block, update ThenBB for the PHI.
-  ThenBB = Builder.GetInsertBlock();
-
-  // Emit else block.
-  TheFunction->getBasicBlockList().push_back(ElseBB);
-  Builder.SetInsertPoint(ElseBB);
-
-  Value *ElseV = Else->codegen();
-  if (!ElseV)
-    return nullptr;
-
-  Builder.CreateBr(MergeBB);
-  // Codegen of 'Else' can change the current block, update ElseBB for the PHI.
-  ElseBB = Builder.GetInsertBlock();
-
-  // Emit merge block.
-  TheFunction->getBasicBlockList().push_back(MergeBB);
-  Builder.SetInsertPoint(MergeBB);
-  PHINode *PN = Builder.CreatePHI(Type::getInt32Ty(TheContext), 2, "iftmp");
-
-  PN->addIncoming(ThenV, ThenBB);
-  PN->addIncoming(ElseV, ElseBB);
-  return PN;
-}
-
-Value * mila::WhileExprAST::codegen()
-{
-  Function *TheFunction = Builder.GetInsertBlock()->getParent();
-
-  // Make the new basic block for the loop header, inserting after current
-  // block.
-  BasicBlock *CondBB = BasicBlock::Create(TheContext, "cond", TheFunction);
-  // Create blocks for the body and exit.  Insert the 'cond' block at the
-  // end of the function.
-  BasicBlock *LoopBB = BasicBlock::Create(TheContext, "loop");
-  BasicBlock *ExitBB = BasicBlock::Create(TheContext, "exit");
-
-  // Insert an explicit fall through from the current block to the LoopBB.
-  Builder.CreateBr(CondBB);
-
-  // Start insertion in LoopBB.
-  Builder.SetInsertPoint(CondBB);
-  Value *CondV = Cond->codegen();
-  if (!CondV)
-    return nullptr;
-
-  // Convert condition to a bool by comparing non-equal to 0.0.
-  CondV = Builder.CreateICmpNE(
-      CondV, ConstantInt::get(TheContext, APInt(32, 0, true)), "ifcond");
-
-
-  Builder.CreateCondBr(CondV, LoopBB, ExitBB);
-
-  // Emit then value.
-  TheFunction->getBasicBlockList().push_back(LoopBB);
-  Builder.SetInsertPoint(LoopBB);
-
-  Value *LoopV = Body->codegen();
-  if (!LoopV)
-    return nullptr;
-  Builder.CreateBr(CondBB);
-
-  TheFunction->getBasicBlockList().push_back(ExitBB);
-  Builder.SetInsertPoint(ExitBB);
-
-  return Constant::getNullValue(Type::getInt32Ty(TheContext));
-}
-
-//#######################################################################################
-
-Value * mila::VariableExprAST::alloca ( void ) const
-{
-    std::string sugar = Name + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    Value * ret = NamedValues [ sugar ];
-    if (!ret)
-        throw ("Unknown variable name");
-    return ret;
-}
-
-Value * mila::ArrayExprAST::alloca ( void ) const
-{
-    std::string sugar = Name + '/' + Builder.GetInsertBlock()->getParent()->getName().str();
-    Value * V = NamedValues [ sugar ];
-    if (!V)
-        throw ("Unknown array name");
-    auto ptr = Builder.CreateGEP(Type::getInt32Ty(TheContext), V, Index->codegen());
-    return ptr;
-}
-
-//#######################################################################################
-
-void mila::ExprListAST::print ( void ) const
-{
-    std::cerr << "<List>" << std::endl;
-    for (const auto &expr : Nodes)
-        if (expr)
-            expr->print();
-        else
-            std::cerr << "nullptr" << std::endl;
-    std::cerr << "</List>" << std::endl;
-}
-
-void mila::NumberExprAST::print ( void ) const
-{
-    std::cerr << "<Number> " << Val << " </Number>" << std::endl;
-}
-
-void mila::ConstExprAST::print ( void ) const
-{
-    std::cerr << "<Const> " << Name << " = " << Val << " </Const>" << std::endl;
-}
-
-void mila::DeclareExprAST::print ( void ) const
-{
-    std::cerr << "<Declare> " << Name << " [" << -Offset << ".." << Length - Offset << "] </Declare>" << std::endl;
-}
+//===----------------------------------------------------------------------===//
+// Name resolution
+//===----------------------------------------------------------------------===//
 
-void mila::VariableExprAST::print ( void ) const
+namespace
 {
-    std::cerr << "<Variable> " << Name << " </Variable>" << std::endl;
-}
+    /// Symbol - What a name stands for in a scope. Only routines use
+    /// arguments and defined, the latter is set once the body was seen.
+    /// Array is set for variables declared with an index range.
+    struct Symbol
+    {
+        enum Kind { CONSTANT, VARIABLE, ROUTINE } kind;
+        std::uint32_t slot;
+        std::size_t arguments;
+        bool defined;
+        bool array;
+    };
 
-void mila::ArrayExprAST::print ( void ) const
-{
-    std::cerr << "<Array> " << Name << " [";
-    Index->print();
-    std::cerr << "] </Array>" << std::endl;
-}
+    typedef std::unordered_map < SymbolId, Symbol > Scope;
 
-void mila::BinaryExprAST::print ( void ) const
-{
-    std::cerr << "<Binary>" << std::endl;
-    LHS->print();
-    std::cerr << Op << std::endl;
-    RHS->print();
-    std::cerr << "</Binary>" << std::endl;
+    /// Resolver - One walk over the tree with a stack of scopes. The global
+    /// scope holds the builtins, constants and routines. The main block and
+    /// every routine have a scope of their own right above it, variables of
+    /// one function are not seen from another as they live on its stack.
+    /// The walk keeps its own stack of work instead of recursing, so deep
+    /// nesting does not run out of the thread stack.
+    class Resolver
+    {
+        public:
+            Resolver ( Ast & ast, std::vector < std::uint32_t > & slots ) : ast ( ast ), slots ( slots ) {}
+
+            std::vector < std::string > program ( NodeId node )
+            {
+                scopes . resize ( 1 );
+                scopes [ 0 ] [ intern ( "writeln" ) ] = Symbol { Symbol::ROUTINE, SLOT_WRITELN, 1, true };
+                scopes [ 0 ] [ intern ( "printi" ) ] = Symbol { Symbol::ROUTINE, SLOT_PRINTI, 1, true };
+                next = BUILTIN_SLOT_CNT;
+                scopes . emplace_back ();
+                resolve ( ast . child ( node, 0 ) );
+                resolve ( ast . child ( node, 1 ) );
+                return errors;
+            }
+
+            std::uint32_t slotCount ( void ) const { return next; }
+
+        private:
+            /// Action - Work left for the walk: visit a node, take the
+            /// result variable of a function from the slot of a node or
+            /// leave the scope of a routine.
+            struct Action
+            {
+                enum { VISIT, RESULT, LEAVE } what;
+                NodeId node;
+            };
+
+            void resolve ( NodeId node )
+            {
+                work . push_back ( Action { Action::VISIT, node } );
+                while ( !work . empty () )
+                {
+                    Action action = work . back ();
+                    work . pop_back ();
+                    switch ( action . what )
+                    {
+                        case Action::VISIT:
+                            visit ( action . node );
+                            break;
+                        case Action::RESULT:
+                            result = slots [ action . node ];
+                            break;
+                        case Action::LEAVE:
+                            scopes . pop_back ();
+                            where = 0;
+                            result = NO_SLOT;
+                            break;
+                    }
+                }
+            }
+
+            /// later - Visit node once the work pushed before it is done.
+            void later ( NodeId node )
+            {
+                work . push_back ( Action { Action::VISIT, node } );
+            }
+
+            /// children - Visit the children of node in order.
+            void children ( NodeId node )
+            {
+                Ast::ChildRange range = ast . childrenOf ( node );
+                for ( std::size_t i = range . size () ; i > 0 ; i -- )
+                    later ( range [ i - 1 ] );
+            }
+
+            /// visit - Bind the names of node itself and push its children.
+            void visit ( NodeId node )
+            {
+                switch ( ast . kind ( node ) )
+                {
+                    case NODE_NUMBER:
+                        break;
+                    case NODE_CONST:
+                        declare ( scopes . front (), node, Symbol::CONSTANT );
+                        break;
+                    case NODE_DECLARE:
+                        declare ( scopes . back (), node, Symbol::VARIABLE );
+                        break;
+                    case NODE_VARIABLE:
+                        use ( node, ast . name ( node ), false );
+                        break;
+                    case NODE_ARRAY:
+                        use ( node, ast . name ( node ), false );
+                        later ( ast . child ( node, 0 ) );
+                        break;
+                    case NODE_BINARY:
+                        later ( ast . child ( node, 1 ) );
+                        if ( ast . op ( node ) == ASSIGN )
+                        {
+                            NodeId target = ast . child ( node, 0 );
+                            use ( target, ast . name ( target ), true );
+                            if ( ast . kind ( target ) == NODE_ARRAY )
+                                later ( ast . child ( target, 0 ) );
+                        }
+                        else
+                            later ( ast . child ( node, 0 ) );
+                        break;
+                    case NODE_FOR:
+                        use ( node, ast . name ( node ), true );
+                        children ( node );
+                        break;
+                    case NODE_CALL:
+                        call ( node );
+                        children ( node );
+                        break;
+                    case NODE_LIBRARY:
+                    {
+                        NodeId target = ast . child ( node, 0 );
+                        use ( target, ast . name ( target ), true );
+                        break;
+                    }
+                    case NODE_RETURN:
+                        slots [ node ] = result;
+                        break;
+                    case NODE_PROTOTYPE:
+                        routine ( node, false );
+                        break;
+                    case NODE_FUNCTION:
+                        function ( node );
+                        break;
+                    default:
+                        children ( node );
+                }
+            }
+
+            void declare ( Scope & scope, NodeId node, Symbol::Kind kind )
+            {
+                SymbolId name = ast . name ( node );
+                if ( scope . count ( name ) )
+                    error ( "Redeclared name ", name );
+                slots [ node ] = next;
+                bool array = kind == Symbol::VARIABLE && ast . childCount ( node );
+                scope [ name ] = Symbol { kind, next ++, 0, false, array };
+            }
+
+            /// lookup - The innermost scope, then the global one.
+            const Symbol * lookup ( SymbolId name ) const
+            {
+                for ( const Scope * scope : { &scopes . back (), &scopes . front () } )
+                {
+                    auto found = scope -> find ( name );
+                    if ( found != scope -> end () )
+                        return &found -> second;
+                }
+                return nullptr;
+            }
+
+            /// use - A variable, or constant unless assigned, named at node.
+            /// Only an array node indexes and only an array is indexed.
+            void use ( NodeId node, SymbolId name, bool assigned )
+            {
+                const Symbol * symbol = lookup ( name );
+                bool indexed = ast . kind ( node ) == NODE_ARRAY;
+                if ( !symbol )
+                    error ( "Undeclared name ", name );
+                else if ( symbol -> kind == Symbol::ROUTINE )
+                    error ( "Routine used as a variable ", name );
+                else if ( assigned && symbol -> kind == Symbol::CONSTANT )
+                    error ( "Assignment to constant ", name );
+                else if ( indexed && !symbol -> array )
+                    error ( "Indexed non-array ", name );
+                else if ( !indexed && symbol -> array )
+                    error ( "Array used as a scalar ", name );
+                else
+                    slots [ node ] = symbol -> slot;
+            }
+
+            /// call - Routines are global, a function calls itself even
+            /// though its result variable has the same name.
+            void call ( NodeId node )
+            {
+                SymbolId name = ast . name ( node );
+                auto found = scopes . front () . find ( name );
+                if ( found == scopes . front () . end () )
+                    error ( "Undeclared routine ", name );
+                else if ( found -> second . kind != Symbol::ROUTINE )
+                    error ( "Call of a constant ", name );
+                else if ( found -> second . arguments != ast . childCount ( node ) )
+                    error ( "Wrong number of arguments to ", name );
+                else
+                    slots [ node ] = found -> second . slot;
+            }
+
+            /// routine - Declare the routine of prototype node, defined if its
+            /// body follows. A forward declaration shares the slot.
+            void routine ( NodeId node, bool body )
+            {
+                SymbolId name = ast . name ( node );
+                auto found = scopes . front () . find ( name );
+                if ( found == scopes . front () . end () )
+                {
+                    slots [ node ] = next;
+                    scopes . front () [ name ] = Symbol { Symbol::ROUTINE, next ++, ast . childCount ( node ), body };
+                    return;
+                }
+                Symbol & symbol = found -> second;
+                if ( symbol . kind != Symbol::ROUTINE || ( body && symbol . defined ) )
+                    error ( "Redeclared name ", name );
+                else if ( symbol . arguments != ast . childCount ( node ) )
+                    error ( "Forward declaration differs from ", name );
+                symbol . defined = symbol . defined || body;
+                slots [ node ] = symbol . slot;
+            }
+
+            /// function - Prototype, locals, then for a function its result
+            /// DECLARE, the block and the result VARIABLE. The scope of the
+            /// routine is left after the last of them.
+            void function ( NodeId node )
+            {
+                NodeId proto = ast . child ( node, 0 );
+                routine ( proto, true );
+                scopes . emplace_back ();
+                where = ast . name ( proto );
+                for ( NodeId arg : ast . childrenOf ( proto ) )
+                    declare ( scopes . back (), arg, Symbol::VARIABLE );
+                std::size_t size = ast . childCount ( node );
+                bool value = ast . kind ( ast . child ( node, size - 1 ) ) == NODE_VARIABLE;
+                work . push_back ( Action { Action::LEAVE, node } );
+                for ( std::size_t i = size - 1 ; i > 0 ; i -- )
+                {
+                    if ( value && i == size - 3 )
+                        work . push_back ( Action { Action::RESULT, ast . child ( node, i ) } );
+                    later ( ast . child ( node, i ) );
+                }
+            }
+
+            void error ( const char * what, SymbolId name )
+            {
+                errors . push_back ( what + symbolName ( name )
+                                     + ( where ? " in " + symbolName ( where ) : " in the main block" ) );
+            }
+
+            Ast & ast;
+            std::vector < std::uint32_t > & slots;
+            std::vector < Scope > scopes;
+            std::vector < Action > work;
+            std::vector < std::string > errors;
+            std::uint32_t next = 0;
+            /// The routine being resolved, 0 in the main block.
+            SymbolId where = 0;
+            /// Slot of the result of the function being resolved.
+            std::uint32_t result = NO_SLOT;
+    };
 }
 
-void mila::IfExprAST::print ( void ) const
+std::vector < std::string > mila::resolve ( Ast & ast, NodeId program )
 {
-    std::cerr << "<If>" << std::endl;
-    std::cerr << "<Condition>" << std::endl;
-    Cond->print();
-    std::cerr << "</Condition>" << std::endl;
-    std::cerr << "<Then>" << std::endl;
-    Then->print();
-    std::cerr << "</Then>" << std::endl;
-    std::cerr << "<Else>" << std::endl;
-    if (Else)
-        Else->print();
-    else
-        std::cerr << "nullptr" << std::endl;
-    std::cerr << "</Else>" << std::endl;
-    std::cerr << "</If>" << std::endl;
+    ast . slots . assign ( ast . size (), NO_SLOT );
+    Resolver resolver ( ast, ast . slots );
+    std::vector < std::string > errors = resolver . program ( program );
+    ast . slotCnt = resolver . slotCount ();
+    return errors;
 }
 
-void mila::ForExprAST::print ( void ) const
-{
-    std::cerr << "<For>" << std::endl;
-    std::cerr << "Start: ";
-    Start->print();
-    std::cerr << std::endl;
-    std::cerr << "End: ";
-    End->print();
-    std::cerr << std::endl;
-    std::cerr << "Step: ";
-    Step->print();
-    std::cerr << std::endl;
-    std::cerr << "Do:" << std::endl;
-    Body->print();
-    std::cerr << "</For>" << std::endl;
-}
+//===----------------------------------------------------------------------===//
+// Constant folding
+//===----------------------------------------------------------------------===//
 
-void mila::WhileExprAST::print ( void ) const
+namespace
 {
-    std::cerr << "<While>" << std::endl;
-    std::cerr << "<Condition>" << std::endl;
-    Cond->print();
-    std::cerr << "</Condition>" << std::endl;
-    std::cerr << "<Body>" << std::endl;
-    Body->print();
-    std::cerr << "</Body>" << std::endl;
-    std::cerr << "</While>" << std::endl;
+    /// evaluate - Result of l op r as the generated code computes it: 32 bit
+    /// arithmetic that wraps around and comparisons giving -1 for true.
+    /// False for a division the program would trap on, it is left to run.
+    bool evaluate ( OperEnum op, int l, int r, int & result )
+    {
+        std::uint32_t a = l, b = r;
+        switch ( op )
+        {
+            case ADD:  result = int ( a + b ); return true;
+            case SUB:  result = int ( a - b ); return true;
+            case MULT: result = int ( a * b ); return true;
+            case DIV:
+            case MOD:
+                if ( !r || ( l == INT_MIN && r == -1 ) )
+                    return false;
+                result = op == DIV ? l / r : l % r;
+                return true;
+            case LT:   result = - ( l < r ); return true;
+            case LE:   result = - ( l <= r ); return true;
+            case GT:   result = - ( l > r ); return true;
+            case GE:   result = - ( l >= r ); return true;
+            case EQ:   result = - ( l == r ); return true;
+            case NE:   result = - ( l != r ); return true;
+            case AND:  result = - ( l && r ); return true;
+            case OR:   result = l | r; return true;
+            default:   return false;
+        }
+    }
 }
 
-void mila::CallExprAST::print ( void ) const
+void mila::fold ( Ast & ast )
 {
-    std::cerr << "<Call> " << Callee << std::endl;
-    for (const auto &arg : Args)
-        arg->print();
-    std::cerr << "</Call>" << std::endl;
-}
+    std::unordered_map < std::uint32_t, int > constants;
+    for ( NodeId node = 0 ; node < ast . size () ; node ++ )
+        if ( ast . kind ( node ) == NODE_CONST )
+            constants [ ast . slot ( node ) ] = ast . value ( ast . child ( node, 0 ) );
 
-void mila::PrototypeAST::print ( void ) const
-{
-    std::cerr << "<Prototype> " << Name << std::endl;
-    for (const auto &arg : Args)
-        std::cerr << arg << std::endl;
-    std::cerr << "</Prototype>" << std::endl;
+    // Children come before their parents, so one pass in order sees every
+    // operand folded already. A folded node is rewritten in place, the
+    // nodes below it stay in the table unused.
+    auto number = [&] ( NodeId node, int value )
+    {
+        ast . literals . push_back ( value );
+        ast . kinds [ node ] = NODE_NUMBER;
+        ast . ops [ node ] = ASSIGN;
+        ast . heads [ node ] = ast . literals . size () - 1;
+        ast . counts [ node ] = 0;
+        ast . slots [ node ] = NO_SLOT;
+        ast . directed . erase ( node );
+    };
+    auto known = [&] ( NodeId node, std::size_t i ) { return ast . kind ( ast . child ( node, i ) ) == NODE_NUMBER; };
+    for ( NodeId node = 0 ; node < ast . size () ; node ++ )
+    {
+        switch ( ast . kind ( node ) )
+        {
+            case NODE_VARIABLE:
+            {
+                auto found = constants . find ( ast . slot ( node ) );
+                if ( found != constants . end () )
+                    number ( node, found -> second );
+                break;
+            }
+            case NODE_BINARY:
+            {
+                int result;
+                if ( ast . op ( node ) != ASSIGN && known ( node, 0 ) && known ( node, 1 )
+                        && evaluate ( ast . op ( node ), ast . value ( ast . child ( node, 0 ) ),
+                                      ast . value ( ast . child ( node, 1 ) ), result ) )
+                    number ( node, result );
+                break;
+            }
+            case NODE_IF:
+                if ( known ( node, 0 ) )
+                {
+                    // the node becomes the branch taken
+                    NodeId branch = ast . child ( node, ast . value ( ast . child ( node, 0 ) ) ? 1 : 2 );
+                    ast . kinds [ node ] = ast . kinds [ branch ];
+                    ast . ops [ node ] = ast . ops [ branch ];
+                    ast . heads [ node ] = ast . heads [ branch ];
+                    ast . firsts [ node ] = ast . firsts [ branch ];
+                    ast . counts [ node ] = ast . counts [ branch ];
+                    ast . slots [ node ] = ast . slots [ branch ];
+                    // a branch is a block or a command, without directives
+                    ast . directed . erase ( node );
+                }
+                break;
+            case NODE_WHILE:
+                if ( known ( node, 0 ) && !ast . value ( ast . child ( node, 0 ) ) )
+                    number ( node, 0 );
+                break;
+            default:
+                break;
+        }
+    }
 }
 
-void mila::FunctionAST::print ( void ) const
-{
-    std::cerr << "<Function> " << std::endl;
-    Proto->print();
-    for (const auto &comm : Body)
-        comm->print();
-    std::cerr << "</Function>" << std::endl;
-}
+//===----------------------------------------------------------------------===//
+// Printing
+//===----------------------------------------------------------------------===//
 
-void mila::LibraryExprAST::print ( void ) const
+namespace
 {
-    std::cerr << "<Library> " << Name << ": " << Arg << "</Library>" << std::endl;
-}
+    /// Piece - What print writes next, a text or the subtree of a node.
+    struct Piece
+    {
+        NodeId node;
+        std::string text;
+    };
 
-void mila::ReturnExprAST::print ( void ) const
-{
-    std::cerr << "<Return></Return>" << std::endl;
+    const NodeId TEXT = UINT32_MAX;
 }
 
-//#######################################################################################
-
-/// CreateEntryBlockAlloca - Create an alloca instruction in the entry block of
-/// the function.  This is used for mutable variables etc.
-AllocaInst * mila::CreateEntryBlockAlloca(Function *TheFunction,
-                                          const std::string &VarName)
+void mila::print ( const Ast & ast, NodeId root )
 {
-    IRBuilder<> TmpB(&TheFunction->getEntryBlock(),
-            TheFunction->getEntryBlock().begin());
-    return TmpB.CreateAlloca(Type::getInt32Ty(TheContext), 0,
-            VarName.c_str());
+    // Pieces left to write, the next one last. A node is replaced by its own
+    // pieces, so deep nesting grows the vector and not the thread stack.
+    std::vector < Piece > stack { Piece { root, "" } };
+    std::vector < Piece > pieces;
+    auto text = [&] ( std::string text ) { pieces . push_back ( Piece { TEXT, std::move ( text ) } ); };
+    auto subtree = [&] ( NodeId node ) { pieces . push_back ( Piece { node, "" } ); };
+    auto name = [&] ( NodeId node ) { return symbolName ( ast . name ( node ) ); };
+    while ( !stack . empty () )
+    {
+        Piece piece = std::move ( stack . back () );
+        stack . pop_back ();
+        if ( piece . node == TEXT )
+        {
+            std::cerr << piece . text;
+            continue;
+        }
+        NodeId node = piece . node;
+        pieces . clear ();
+        switch ( ast . kind ( node ) )
+        {
+            case NODE_PROGRAM:
+                text ( "<Program> " + name ( node ) + "\n" );
+                subtree ( ast . child ( node, 0 ) );
+                subtree ( ast . child ( node, 1 ) );
+                text ( "</Program>\n" );
+                break;
+            case NODE_LIST:
+                text ( "<List>\n" );
+                for ( NodeId item : ast . childrenOf ( node ) )
+                    subtree ( item );
+                text ( "</List>\n" );
+                break;
+            case NODE_NUMBER:
+                text ( "<Number> " + std::to_string ( ast . value ( node ) ) + " </Number>\n" );
+                break;
+            case NODE_CONST:
+                text ( "<Const> " + name ( node ) + " = " + std::to_string ( ast . value ( ast . child ( node, 0 ) ) ) + " </Const>\n" );
+                break;
+            case NODE_DECLARE:
+            {
+                int offset = 0, length = 0;
+                if ( ast . childCount ( node ) )
+                {
+                    offset = ast . value ( ast . child ( node, 0 ) );
+                    length = ast . value ( ast . child ( node, 1 ) );
+                }
+                text ( "<Declare> " + name ( node ) + " [" + std::to_string ( -offset ) + ".." + std::to_string ( length - offset ) + "] </Declare>\n" );
+                break;
+            }
+            case NODE_VARIABLE:
+                text ( "<Variable> " + name ( node ) + " </Variable>\n" );
+                break;
+            case NODE_ARRAY:
+                text ( "<Array> " + name ( node ) + " [" );
+                subtree ( ast . child ( node, 0 ) );
+                text ( "] </Array>\n" );
+                break;
+            case NODE_BINARY:
+                text ( "<Binary>\n" );
+                subtree ( ast . child ( node, 0 ) );
+                text ( std::to_string ( ast . op ( node ) ) + "\n" );
+                subtree ( ast . child ( node, 1 ) );
+                text ( "</Binary>\n" );
+                break;
+            case NODE_IF:
+                text ( "<If>\n<Condition>\n" );
+                subtree ( ast . child ( node, 0 ) );
+                text ( "</Condition>\n<Then>\n" );
+                subtree ( ast . child ( node, 1 ) );
+                text ( "</Then>\n<Else>\n" );
+                subtree ( ast . child ( node, 2 ) );
+                text ( "</Else>\n</If>\n" );
+                break;
+            case NODE_FOR:
+                text ( "<For>\nStart: " );
+                subtree ( ast . child ( node, 0 ) );
+                text ( "\nEnd: " );
+                subtree ( ast . child ( node, 1 ) );
+                text ( "\nStep: " );
+                subtree ( ast . child ( node, 2 ) );
+                text ( "\nDo:\n" );
+                subtree ( ast . child ( node, 3 ) );
+                text ( "</For>\n" );
+                break;
+            case NODE_WHILE:
+                text ( "<While>\n<Condition>\n" );
+                subtree ( ast . child ( node, 0 ) );
+                text ( "</Condition>\n<Body>\n" );
+                subtree ( ast . child ( node, 1 ) );
+                text ( "</Body>\n</While>\n" );
+                break;
+            case NODE_CALL:
+                text ( "<Call> " + name ( node ) + "\n" );
+                for ( NodeId arg : ast . childrenOf ( node ) )
+                    subtree ( arg );
+                text ( "</Call>\n" );
+                break;
+            case NODE_LIBRARY:
+                text ( "<Library> " + name ( node ) + ": " + name ( ast . child ( node, 0 ) ) + "</Library>\n" );
+                break;
+            case NODE_RETURN:
+                text ( "<Return></Return>\n" );
+                break;
+            case NODE_PROTOTYPE:
+                text ( "<Prototype> " + name ( node ) + "\n" );
+                for ( NodeId arg : ast . childrenOf ( node ) )
+                    text ( name ( arg ) + "\n" );
+                text ( "</Prototype>\n" );
+                break;
+            case NODE_FUNCTION:
+                text ( "<Function> \n" );
+                for ( NodeId item : ast . childrenOf ( node ) )
+                    subtree ( item );
+                text ( "</Function>\n" );
+                break;
+            default:
+                break;
+        }
+        stack . insert ( stack . end (), std::make_move_iterator ( pieces . rbegin () ), std::make_move_iterator ( pieces . rend () ) );
+    }
 }
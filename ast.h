@@ -1,108 +1,17 @@
-#include "llvm/ADT/APFloat.h"
-#include "llvm/ADT/STLExtras.h"
-#include "llvm/IR/BasicBlock.h"
-#include "llvm/IR/Constants.h"
-#include "llvm/IR/DerivedTypes.h"
-#include "llvm/IR/Function.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/IRBuilder.h"
-#include "llvm/IR/LLVMContext.h"
-#include "llvm/IR/Module.h"
-#include "llvm/IR/Type.h"
-#include "llvm/IR/Verifier.h"
-#include <cctype>
-#include <cstdio>
-#include <cstdlib>
-#include <map>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <string>
+#include <unordered_map>
 #include <vector>
-
-using namespace llvm;
+#include "interner.h"
 
 #ifndef AST_H
 #define AST_H
 
 namespace mila
 {
-    class ExprAST 
-    {
-        public:
-            virtual ~ExprAST() {}
-            virtual Value *codegen() = 0;
-            virtual void print() const = 0;
-    };
-
-    class ExprListAST : public ExprAST
-    {
-        std::vector<std::unique_ptr<ExprAST>> Nodes;
-
-        public:
-        ExprListAST(std::vector<std::unique_ptr<ExprAST>> Nodes) : Nodes(std::move(Nodes)) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// NumberExprAST - Expression class for numeric literals like "1".
-    class NumberExprAST : public ExprAST 
-    {
-        int Val;
-
-        public:
-        NumberExprAST(int Val) : Val(Val) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    class ConstExprAST : public ExprAST
-    {
-        std::string Name;
-        int Val;
-
-        public:
-        ConstExprAST(const std::string &Name, int Val) : Name(Name), Val(Val) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    class DeclareExprAST : public ExprAST
-    {
-        std::string Name;
-        int Offset;
-        int Length;
-
-        public:
-        DeclareExprAST(const std::string &Name, int Offset = 0, int Length = 0) : Name(Name), Offset(Offset), Length(Length) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// VariableExprAST - Expression class for referencing a variable, like "a".
-    class VariableExprAST : public ExprAST 
-    {
-        protected:
-        std::string Name;
-
-        public:
-        VariableExprAST(const std::string &Name) : Name(Name) {}
-        Value *codegen() override;
-        void print() const override;
-        const std::string &getName() const { return Name; }
-        virtual Value *alloca() const;
-    };
-
-    class ArrayExprAST : public VariableExprAST
-    {
-        std::unique_ptr<ExprAST> Index;
-
-        public:
-        ArrayExprAST(const std::string &Name, std::unique_ptr<ExprAST> Index) : VariableExprAST(Name), Index(std::move(Index)) {}
-        Value *codegen() override;
-        void print() const override;
-        virtual Value *alloca() const;
-    };
-
-    enum OperEnum 
+    enum OperEnum
     {
         ASSIGN, // 0
         ADD,    // 1
@@ -122,139 +31,154 @@ namespace mila
 
     int getPrecedence (OperEnum op);
 
-    /// BinaryExprAST - Expression class for a binary operator.
-    class BinaryExprAST : public ExprAST 
-    {
-        OperEnum Op;
-        std::unique_ptr<ExprAST> LHS, RHS;
-
-        public:
-        BinaryExprAST(OperEnum Op, std::unique_ptr<ExprAST> LHS,
-                std::unique_ptr<ExprAST> RHS)
-            : Op(Op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// IfExprAST - Expression class for if/then/else.
-    class IfExprAST : public ExprAST
-    {
-        std::unique_ptr<ExprAST> Cond, Then, Else;
-
-        public:
-        IfExprAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<ExprAST> Then,
-                std::unique_ptr<ExprAST> Else)
-            : Cond(std::move(Cond)), Then(std::move(Then)), Else(std::move(Else)) {}
-
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// ForExprAST - Expression class for for/in.
-    class ForExprAST : public ExprAST
-    {
-        std::string VarName;
-        std::unique_ptr<ExprAST> Start, End, Step, Body;
-
-        public:
-        ForExprAST(const std::string &VarName, std::unique_ptr<ExprAST> Start,
-                std::unique_ptr<ExprAST> End, std::unique_ptr<ExprAST> Step,
-                std::unique_ptr<ExprAST> Body)
-            : VarName(VarName), Start(std::move(Start)), End(std::move(End)),
-            Step(std::move(Step)), Body(std::move(Body)) {}
-
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    class WhileExprAST : public ExprAST
-    {
-        std::unique_ptr<ExprAST> Cond, Body;
-
-        public:
-        WhileExprAST(std::unique_ptr<ExprAST> Cond, std::unique_ptr<ExprAST> Body)
-            : Cond(std::move(Cond)), Body(std::move(Body)) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// CallExprAST - Expression class for function calls.
-    class CallExprAST : public ExprAST 
-    {
-        std::string Callee;
-        std::vector<std::unique_ptr<ExprAST>> Args;
-
-        public:
-        CallExprAST(const std::string &Callee,
-                std::vector<std::unique_ptr<ExprAST>> Args)
-            : Callee(Callee), Args(std::move(Args)) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    class LibraryExprAST : public ExprAST
-    {
-        std::string Name;
-        std::string Arg;
-
-        public:
-        LibraryExprAST(const std::string &Name, const std::string &Arg) : Name(Name), Arg(Arg) {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    class ReturnExprAST : public ExprAST
-    {
-        public:
-        ReturnExprAST() {}
-        Value *codegen() override;
-        void print() const override;
-    };
-
-    /// PrototypeAST - This class represents the "prototype" for a function,
-    /// which captures its name, and its argument names (thus implicitly the number
-    /// of arguments the function takes).
-    class PrototypeAST : public ExprAST
-    {
-        std::string Name;
-        std::vector<std::string> Args;
-
-        public:
-        PrototypeAST(const std::string &Name, std::vector<std::string> Args)
-            : Name(Name), Args(std::move(Args)) {}
-        Function *codegen() override;
-        void print() const override;
-        const std::string &getName() const { return Name; }
-    };
-
-    /// FunctionAST - This class represents a function definition itself.
-    class FunctionAST : public ExprAST
-    {
-        std::unique_ptr<PrototypeAST> Proto;
-        std::vector<std::unique_ptr<ExprAST>> Body;
-
-        public:
-        FunctionAST(std::unique_ptr<PrototypeAST> Proto,
-                std::vector<std::unique_ptr<ExprAST>> Body)
-            : Proto(std::move(Proto)), Body(std::move(Body)) {}
-        Function *codegen() override;
-        void print() const override;
-    };
-
-    //################################################################################
-    AllocaInst *CreateEntryBlockAlloca(Function *TheFunction,
-                                          const std::string &VarName);
-
-    extern LLVMContext TheContext;
-    extern IRBuilder<> Builder;
-    extern std::unique_ptr<Module> TheModule;
-    extern std::map<std::string, Value *> NamedValues;
-    extern std::map<std::string, Value *> ConstValues;
-    //static std::unique_ptr<legacy::FunctionPassManager> TheFPM;
-    extern std::map<std::string, std::unique_ptr<PrototypeAST>> FunctionProtos;
-    extern std::map<std::string, Function *> Library;
-    extern Function *main_func;
-    extern BasicBlock *mainBlock;
+    /// NodeKind - Tag of an AST node. The comments give the head of the node
+    /// and its children in order.
+    enum NodeKind : std::uint8_t
+    {
+        NODE_PROGRAM,       // name; declarations, block
+        NODE_LIST,          // -; items...
+        NODE_NUMBER,        // literal; -
+        NODE_CONST,         // name; number
+        NODE_DECLARE,       // name; - or offset and length numbers of an array
+        NODE_VARIABLE,      // name; -
+        NODE_ARRAY,         // name; index
+        NODE_BINARY,        // -; lhs, rhs, the operator is kept by op ()
+        NODE_IF,            // -; cond, then, else
+        NODE_FOR,           // variable name; start, end, step, body
+        NODE_WHILE,         // -; cond, body
+        NODE_CALL,          // callee name; arguments...
+        NODE_LIBRARY,       // procedure name; variable
+        NODE_RETURN,        // -; -
+        NODE_PROTOTYPE,     // name; variable per argument...
+        NODE_FUNCTION,      // -; prototype, body...
+        NODE_KIND_CNT
+    };
+
+    /// NodeId - Index of a node in its Ast.
+    typedef std::uint32_t NodeId;
+
+    /// NO_SLOT - Slot of a node which does not name anything.
+    const std::uint32_t NO_SLOT = UINT32_MAX;
+
+    /// BuiltinSlot - Slots of the routines a program calls without declaring
+    /// them, the slots of its own declarations follow.
+    enum BuiltinSlot : std::uint32_t
+    {
+        SLOT_WRITELN,
+        SLOT_PRINTI,
+        BUILTIN_SLOT_CNT
+    };
+
+    /// Directives - What the {$...} directives written before a loop, an if
+    /// or a routine ask of codegen. Zero leaves it to LLVM.
+    struct Directives
+    {
+        int unroll = 0;     // {$unroll N} unrolls N times, N = 1 not at all, {$unroll} -1
+        int vectorize = 0;  // {$vectorize N} uses width N, N = 1 not at all, {$vectorize} -1
+        int inlining = 0;   // {$inline} 1, {$noinline} -1
+        int likely = 0;     // {$likely} 1, {$unlikely} -1
+
+        bool operator == ( const Directives & other ) const
+        {
+            return unroll == other . unroll && vectorize == other . vectorize
+                && inlining == other . inlining && likely == other . likely;
+        }
+    };
+
+    /// Ast - The syntax tree of one program kept as a table of nodes. Every
+    /// column is a vector indexed by NodeId, children of a node are stored
+    /// next to each other in one shared vector and literals live in a side
+    /// table. Names are the SymbolIds of the interner. Nodes are appended
+    /// bottom up, so children always come before their parent and the whole
+    /// tree goes at once with clear. After resolve every node naming a
+    /// constant, variable or routine also has the slot of its declaration.
+    class Ast
+    {
+        public:
+            /// ChildRange - The children of one node. It stays valid until the
+            /// next node is added.
+            class ChildRange
+            {
+                public:
+                    ChildRange ( const NodeId * first, const NodeId * last ) : first ( first ), last ( last ) {}
+                    const NodeId * begin ( void ) const { return first; }
+                    const NodeId * end ( void ) const { return last; }
+                    std::size_t size ( void ) const { return last - first; }
+                    NodeId operator [] ( std::size_t i ) const { return first [ i ]; }
+                private:
+                    const NodeId * first;
+                    const NodeId * last;
+            };
+
+            NodeId add ( NodeKind kind, std::uint32_t head, const NodeId * first, const NodeId * last, OperEnum op = ASSIGN );
+            NodeId add ( NodeKind kind, std::uint32_t head, std::initializer_list < NodeId > children = {} );
+            NodeId binary ( OperEnum op, NodeId lhs, NodeId rhs );
+            NodeId number ( int value );
+            /// direct - Attach directives to node.
+            void direct ( NodeId node, const Directives & directives );
+            /// append - Add all nodes of other after the nodes of this tree,
+            /// node n of other becomes node base + n. Returns base.
+            NodeId append ( const Ast & other );
+            void clear ( void );
+            bool operator == ( const Ast & other ) const;
+            bool operator != ( const Ast & other ) const { return !( *this == other ); }
+
+            NodeKind kind ( NodeId node ) const { return kinds [ node ]; }
+            OperEnum op ( NodeId node ) const { return OperEnum ( ops [ node ] ); }
+            SymbolId name ( NodeId node ) const { return heads [ node ]; }
+            int value ( NodeId node ) const { return literals [ heads [ node ] ]; }
+            NodeId child ( NodeId node, std::size_t i ) const { return children [ firsts [ node ] + i ]; }
+            std::size_t childCount ( NodeId node ) const { return counts [ node ]; }
+            std::uint32_t slot ( NodeId node ) const { return slots [ node ]; }
+            /// Directives of node, null when it has none.
+            const Directives * directives ( NodeId node ) const
+            {
+                auto found = directed . find ( node );
+                return found == directed . end () ? nullptr : &found -> second;
+            }
+            /// Number of slots resolve handed out, builtins included.
+            std::uint32_t slotCount ( void ) const { return slotCnt; }
+            ChildRange childrenOf ( NodeId node ) const
+            {
+                const NodeId * first = children . data () + firsts [ node ];
+                return ChildRange ( first, first + counts [ node ] );
+            }
+            /// Number of nodes, the last one added is size () - 1.
+            std::size_t size ( void ) const { return kinds . size (); }
+            /// Bytes held by the tables.
+            std::size_t bytes ( void ) const;
+
+        private:
+            std::vector < NodeKind > kinds;
+            std::vector < std::uint8_t > ops;
+            std::vector < std::uint32_t > heads;
+            std::vector < std::uint32_t > firsts;
+            std::vector < std::uint32_t > counts;
+            std::vector < NodeId > children;
+            std::vector < int > literals;
+            std::vector < std::uint32_t > slots;
+            /// Directives of the few nodes which have any.
+            std::unordered_map < NodeId, Directives > directed;
+            std::uint32_t slotCnt = 0;
+
+            friend std::vector < std::string > resolve ( Ast & ast, NodeId program );
+            friend void fold ( Ast & ast );
+    };
+
+    /// resolve - Bind every name in the program to the slot of its
+    /// declaration. Declarations get slots numbered across the whole program,
+    /// so codegen keeps one value per slot in a vector. Returns the
+    /// undeclared and misused names, empty if there are none.
+    std::vector < std::string > resolve ( Ast & ast, NodeId program );
+
+    /// fold - Evaluate what is known before the program runs, on a resolved
+    /// tree. Uses of constants become numbers, operations on numbers become
+    /// their result, an if on a number becomes the branch taken and a while
+    /// on zero goes away. Results are those the generated code would compute.
+    void fold ( Ast & ast );
+
+    /// print - Dump the subtree rooted at node to stderr.
+    void print ( const Ast & ast, NodeId node );
 };
 
 #endif
@@ -0,0 +1,329 @@
+#include "parser.h"
+#include "codegen.h"
+#include "lexan.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <new>
+#include <cstdlib>
+
+using namespace mila;
+using namespace std;
+
+//==========================================================================
+// Allocations are counted to compare memory layouts of the AST, the parse
+// reports how many it made.
+static size_t allocations = 0;
+
+void * operator new ( size_t size )
+{
+    allocations ++;
+    if ( void * p = malloc ( size ? size : 1 ) )
+        return p;
+    throw bad_alloc ();
+}
+
+void operator delete ( void * p ) noexcept
+{
+    free ( p );
+}
+
+void operator delete ( void * p, size_t ) noexcept
+{
+    free ( p );
+}
+//==========================================================================
+struct Options
+{
+    int functions = 2000;
+    int called = -1;
+    unsigned seed = 1;
+    int repeat = 5;
+    unsigned jobs = max ( 2u, thread::hardware_concurrency () );
+    const char * dump = nullptr;
+};
+
+/// Generator - Synthetic program of many functions that codegen accepts:
+/// every name used is a parameter or a local of its function and calls
+/// only go to functions defined before.
+class Generator
+{
+    public:
+        Generator ( unsigned seed ) : rng ( seed ) {}
+
+        /// program - Source of the program, its main block calls the first
+        /// called functions only, all of them when called is negative.
+        string program ( int functions, int called )
+        {
+            os << "program bench;\n";
+            for ( int f = 0 ; f < functions ; f ++ )
+            {
+                defined = f;
+                os << "function f" << f << " ( a : integer; b : integer ) : integer;\n"
+                   << "var i, j, t : integer;\n"
+                   << "    v : array [0 .. 9] of integer;\n"
+                   << "begin\n"
+                   << "    t := a;\n";
+                for ( int s = 2 + rng () % 6 ; s > 0 ; s -- )
+                    statement ( 1 );
+                os << "    f" << f << " := t\nend;\n";
+            }
+            os << "var x : integer;\nbegin\n    x := 0;\n";
+            if ( called < 0 || called > functions )
+                called = functions;
+            for ( int f = 0 ; f < called ; f ++ )
+                os << "    x := f" << f << " ( x, " << f << " );\n";
+            os << "    writeln ( x )\nend.\n";
+            return os . str ();
+        }
+
+    private:
+        void operand ( int depth )
+        {
+            switch ( rng () % ( depth < 3 ? 6 : 3 ) )
+            {
+                case 0:  os << rng () % 1000; break;
+                case 1:  os << "abijt" [ rng () % 5 ]; break;
+                case 2:  os << "t"; break;
+                case 3:  os << "v [ "; expression ( depth + 1 ); os << " mod 10 ]"; break;
+                case 4:  os << "( "; expression ( depth + 1 ); os << " )"; break;
+                default:
+                    if ( !defined )
+                    {
+                        os << "a";
+                        break;
+                    }
+                    os << "f" << rng () % defined << " ( ";
+                    expression ( depth + 1 );
+                    os << ", ";
+                    expression ( depth + 1 );
+                    os << " )";
+            }
+        }
+
+        void expression ( int depth )
+        {
+            static const char * operators [] = { "+", "-", "*", "div", "mod", "<", ">", "=", "<>", "and", "or" };
+            operand ( depth );
+            for ( int n = rng () % 4 ; n > 0 ; n -- )
+            {
+                os << ' ' << operators [ rng () % 11 ] << ' ';
+                operand ( depth );
+            }
+        }
+
+        void indent ( int depth )
+        {
+            os << string ( 4 * depth, ' ' );
+        }
+
+        void block ( int depth )
+        {
+            os << "begin\n";
+            for ( int s = 1 + rng () % 3 ; s > 0 ; s -- )
+                statement ( depth + 1 );
+            indent ( depth );
+            os << "end";
+        }
+
+        void statement ( int depth )
+        {
+            indent ( depth );
+            switch ( depth < 4 ? rng () % 8 : rng () % 3 )
+            {
+                case 0:
+                case 1:
+                    os << "t := ";
+                    expression ( 0 );
+                    break;
+                case 2:
+                    os << "v [ j mod 10 ] := ";
+                    expression ( 0 );
+                    break;
+                case 3:
+                    os << "if ";
+                    expression ( 0 );
+                    os << " then ";
+                    block ( depth );
+                    os << " else ";
+                    block ( depth );
+                    break;
+                case 4:
+                    os << "for " << "ij" [ depth % 2 ] << " := 0 to ";
+                    expression ( 0 );
+                    os << " do ";
+                    block ( depth );
+                    break;
+                case 5:
+                    os << "while t < ";
+                    expression ( 0 );
+                    os << " do ";
+                    block ( depth );
+                    break;
+                case 6:
+                    os << "writeln ( ";
+                    expression ( 0 );
+                    os << " )";
+                    break;
+                default:
+                    os << "inc ( t )";
+            }
+            os << ";\n";
+        }
+
+        mt19937 rng;
+        ostringstream os;
+        int defined = 0;
+};
+
+/// walk - Pass over the tree from the root, dispatched on the node kind as
+/// every pass over the Ast is. Counts nodes and returns the depth.
+static size_t walk ( const Ast & ast, NodeId node, size_t & visited )
+{
+    visited ++;
+    size_t depth = 0;
+    switch ( ast . kind ( node ) )
+    {
+        case NODE_NUMBER:
+        case NODE_VARIABLE:
+        case NODE_RETURN:
+            break;
+        case NODE_BINARY:
+            depth = max ( walk ( ast, ast . child ( node, 0 ), visited ), walk ( ast, ast . child ( node, 1 ), visited ) );
+            break;
+        default:
+            for ( NodeId child : ast . childrenOf ( node ) )
+                depth = max ( depth, walk ( ast, child, visited ) );
+    }
+    return depth + 1;
+}
+
+/// scan - Pass over the node table in order, without following children,
+/// the way a pass looking for patterns does. Counts binary nodes on two
+/// literals.
+static size_t scan ( const Ast & ast )
+{
+    size_t found = 0;
+    for ( NodeId node = 0 ; node < ast . size () ; node ++ )
+        if ( ast . kind ( node ) == NODE_BINARY && ast . kind ( ast . child ( node, 0 ) ) == NODE_NUMBER
+                && ast . kind ( ast . child ( node, 1 ) ) == NODE_NUMBER )
+            found ++;
+    return found;
+}
+
+template < class F >
+static double best ( int repeat, F run )
+{
+    double result = 0;
+    for ( int i = 0 ; i < repeat ; i ++ )
+    {
+        auto begin = chrono::steady_clock::now ();
+        run ();
+        double seconds = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+        if ( !i || seconds < result )
+            result = seconds;
+    }
+    return result;
+}
+
+static void usage ( const char * self )
+{
+    cerr << "usage: " << self << " [-f functions] [-m called] [-s seed] [-r repeat] [-j threads] [-g file]" << endl;
+    exit ( 1 );
+}
+
+int main ( int argc, char ** argv )
+{
+    Options opt;
+    for ( int i = 1 ; i < argc ; i ++ )
+    {
+        if ( argv [ i ] [ 0 ] != '-' || i + 1 == argc )
+            usage ( argv [ 0 ] );
+        const char * arg = argv [ ++ i ];
+        switch ( argv [ i - 1 ] [ 1 ] )
+        {
+            case 'f': opt . functions = atoi ( arg ); break;
+            case 'm': opt . called = atoi ( arg ); break;
+            case 's': opt . seed = atoi ( arg ); break;
+            case 'r': opt . repeat = atoi ( arg ); break;
+            case 'j': opt . jobs = atoi ( arg ); break;
+            case 'g': opt . dump = arg; break;
+            default: usage ( argv [ 0 ] );
+        }
+    }
+
+    string source = Generator ( opt . seed ) . program ( opt . functions, opt . called );
+    if ( opt . dump )
+    {
+        ofstream ( opt . dump ) << source;
+        return 0;
+    }
+
+    try
+    {
+        istringstream is ( source );
+        SourceBuffer buffer ( is );
+        Parser parser ( Lexan ( move ( buffer ) ) );
+        size_t allocated = allocations;
+        auto begin = chrono::steady_clock::now ();
+        NodeId program = parser . parseProgram ();
+        double parsing = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+        allocated = allocations - allocated;
+        const Ast & ast = parser . tree ();
+
+        // Bodies parsed on the thread pool must give the very same tree.
+        istringstream copy ( source );
+        SourceBuffer again ( copy );
+        Parser parallel ( Lexan ( move ( again ) ), opt . jobs );
+        begin = chrono::steady_clock::now ();
+        parallel . parseProgram ();
+        double parallelParsing = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+        if ( parallel . tree () != ast )
+        {
+            cerr << "The parallel parse gave a different tree." << endl;
+            return 1;
+        }
+
+        // The lazy parse leaves out what main does not call.
+        istringstream third ( source );
+        SourceBuffer lazyBuffer ( third );
+        Parser lazy ( Lexan ( move ( lazyBuffer ) ), 1, true );
+        begin = chrono::steady_clock::now ();
+        lazy . parseProgram ();
+        double lazyParsing = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+
+        size_t visited = 0, depth = 0, found = 0;
+        double walking = best ( opt . repeat, [&] { visited = 0; depth = walk ( ast, program, visited ); } );
+        double scanning = best ( opt . repeat, [&] { found = scan ( ast ); } );
+
+        // Codegen fills the one global module, so it runs only once.
+        begin = chrono::steady_clock::now ();
+        codegen ( ast, program );
+        double generating = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+
+        cout << opt . functions << " functions, " << source . size () << " bytes, " << ast . size () << " nodes in "
+             << ast . bytes () << " bytes, depth " << depth << endl
+             << "parse    " << parsing << " s, " << allocated << " allocations" << endl
+             << "parse -j" << opt . jobs << " " << parallelParsing << " s, " << parsing / parallelParsing << "x" << endl
+             << "parse -l " << lazyParsing << " s, " << lazy . tree () . size () << " nodes" << endl
+             << "walk     " << walking << " s, " << visited / walking / 1e6 << " M nodes/s" << endl
+             << "scan     " << scanning << " s, " << ast . size () / scanning / 1e6 << " M nodes/s, "
+             << found << " constant operations" << endl
+             << "codegen  " << generating << " s, " << ast . size () / generating / 1e6 << " M nodes/s" << endl;
+    }
+    catch ( ParserException & e )
+    {
+        cerr << e << endl;
+        return 1;
+    }
+    catch ( const char * e )
+    {
+        cerr << e << endl;
+        return 1;
+    }
+    return 0;
+}
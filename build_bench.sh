@@ -0,0 +1,53 @@
+#!/bin/bash
+# Times building every sample into an executable, as the bitcode written by
+# the parser then llc then gcc, against the parser emitting the object and
+# running the linker itself. Each build is repeated, 10 times unless an
+# argument says otherwise, and the mean wall time in milliseconds is printed.
+
+runs=${1:-10}
+mkdir -p binary
+
+# mean command... - Mean milliseconds of runs runs of the command.
+mean ()
+{
+start=$(date +%s.%N)
+for ((r = 0; r < runs; r++))
+do
+if ! "$@" > /dev/null 2>&1
+then
+echo failed
+return
+fi
+done
+end=$(date +%s.%N)
+awk -v s=$start -v e=$end -v n=$runs 'BEGIN { printf "%.1f", ( e - s ) * 1000 / n }'
+}
+
+# separate sample - The old pipeline, three processes and bitcode in between.
+separate ()
+{
+name=$(sed -n 's/^ *program *\([A-Za-z0-9_]*\).*/\1/p' "$1" | head -1)
+./parser < "$1" &&
+llc binary/$name -filetype=obj -o binary/$name.o &&
+gcc binary/$name.o binary/inc.o -o binary/a.out
+}
+
+# emitted sample - The parser writing the object and linking it.
+emitted ()
+{
+./parser -o binary/a.out < "$1"
+}
+
+printf "%-24s %14s %14s %8s\n" sample "parser+llc+gcc" "parser -o" speedup
+for sample in samples/*.p
+do
+old=$(mean separate "$sample")
+new=$(mean emitted "$sample")
+if [ "$old" = failed ] || [ "$new" = failed ]
+then
+echo "$sample failed to build" >&2
+continue
+fi
+awk -v f=${sample#samples/} -v o=$old -v n=$new \
+    'BEGIN { printf "%-24s %14s %14s %7.1fx\n", f, o, n, o / n }'
+done
@@ -0,0 +1,798 @@
+// Most copied from LLVM's official tutorials about building Kaleidoscope language
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "codegen.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#if LLVM_VERSION_MAJOR >= 14
+#include "llvm/MC/TargetRegistry.h"
+#else
+#include "llvm/Support/TargetRegistry.h"
+#endif
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+using namespace llvm;
+using namespace mila;
+
+namespace mila
+{
+    LLVMContext TheContext;
+    std::unique_ptr<Module> TheModule ( std::make_unique<Module>("mila",TheContext) );
+    IRBuilder<> Builder ( TheContext );
+    std::vector<Value *> Slots;
+};
+
+// runtime - Declare an external function of inc.c taking Params and returning
+// i32, or main.
+static Function *runtime(const char *Name, std::vector<Type *> Params)
+{
+    FunctionType *FT = FunctionType::get(Type::getInt32Ty(TheContext), Params, false);
+    return Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+}
+
+namespace mila
+{
+    std::map<std::string, Function *> Library
+    {
+        { "readln", runtime("readln", {Type::getInt32PtrTy(TheContext)}) },
+        { "inc", runtime("inc", {Type::getInt32PtrTy(TheContext)}) },
+        { "dec", runtime("dec", {Type::getInt32PtrTy(TheContext)}) }
+    };
+
+// Create main function
+Function *main_func = runtime("main", {});
+
+// Create basic block and start inserting into it
+BasicBlock *mainBlock = BasicBlock::Create(TheModule->getContext(), "main.0", main_func);
+};
+
+//===----------------------------------------------------------------------===//
+// Code Generation
+//===----------------------------------------------------------------------===//
+
+// Codegen does not recurse, it keeps its own stack of frames, one for every
+// node it is in the middle of, so how deep the tree nests is limited by the
+// memory only. Every node kind has its own function below. Leaves are
+// generated at once, the other kinds are steps: a step is called when its
+// frame is entered and again after each child it asked for, with the value of
+// that child on top of Values. It returns the next child to generate or Done
+// once it pushed the value of its node in place of its children's values.
+
+namespace
+{
+struct Frame
+{
+    NodeId Node;
+    // Children generated so far.
+    unsigned Step;
+    // What the node keeps between its steps.
+    Value *Val;
+    BasicBlock *BB[3];
+};
+
+const NodeId Done = NO_SLOT;
+
+std::vector<Value *> Values;
+
+// Added to an index of the array in each slot to get the index of the element
+// in its [N x i32], minus the lowest index of the declaration.
+std::vector<int> Offsets;
+
+Value *pop()
+{
+    Value *V = Values.back();
+    Values.pop_back();
+    return V;
+}
+
+// finish - Last step of a node with the given value.
+NodeId finish(Value *V)
+{
+    Values.push_back(V);
+    return Done;
+}
+}
+
+static Value *numberCodegen(const Ast &ast, NodeId node)
+{
+    return ConstantInt::get(TheContext, APInt(32, ast.value(node), true));
+}
+
+static NodeId listStep(const Ast &ast, Frame &F)
+{
+    if (F.Step && !pop())
+        return finish(nullptr);
+    if (F.Step != ast.childCount(F.Node))
+        return ast.child(F.Node, F.Step);
+    return finish(Constant::getNullValue(Type::getInt32Ty(TheContext)));
+}
+
+// Names were resolved to slots before codegen, every declaration stores its
+// value in Slots and every use of the name reads it from there.
+
+static Value *constCodegen(const Ast &ast, NodeId node)
+{
+    // Constants need no storage, they are used as they are.
+    return Slots[ast.slot(node)] = numberCodegen(ast, ast.child(node, 0));
+}
+
+// Variables and arrays live in the entry block of their function, where mem2reg
+// and SROA look for them. An array is one [N x i32] indexed from its start.
+static Value *declareCodegen(const Ast &ast, NodeId node)
+{
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    Type *Ty = nullptr;
+    if (ast.childCount(node))
+    {
+        Ty = ArrayType::get(Type::getInt32Ty(TheContext), ast.value(ast.child(node, 1)));
+        Offsets[ast.slot(node)] = ast.value(ast.child(node, 0));
+    }
+    return Slots[ast.slot(node)] =
+        CreateEntryBlockAlloca(TheFunction, symbolName(ast.name(node)), Ty);
+}
+
+static Value *variableCodegen(const Ast &ast, NodeId node)
+{
+    Value *V = Slots[ast.slot(node)];
+    if (isa<Constant>(V))
+        return V;
+    return Builder.CreateLoad(Builder.getInt32Ty(), V, symbolName(ast.name(node)));
+}
+
+/// element - Address of the element at Index of the array in slot Slot.
+static Value *element(std::uint32_t Slot, Value *Index)
+{
+    AllocaInst *Array = cast<AllocaInst>(Slots[Slot]);
+    if (Offsets[Slot])
+        Index = Builder.CreateAdd(Index, ConstantInt::get(TheContext, APInt(32, Offsets[Slot], true)), "index");
+    Value *Indices[] = {ConstantInt::get(TheContext, APInt(32, 0)), Index};
+    return Builder.CreateInBoundsGEP(Array->getAllocatedType(), Array, Indices, "element");
+}
+
+static NodeId arrayStep(const Ast &ast, Frame &F)
+{
+    if (!F.Step)
+        return ast.child(F.Node, 0);
+    return finish(Builder.CreateLoad(Builder.getInt32Ty(), element(ast.slot(F.Node), pop())));
+}
+
+static NodeId binaryStep(const Ast &ast, Frame &F) {
+  OperEnum Op = ast.op(F.Node);
+  NodeId LHS = ast.child(F.Node, 0), RHS = ast.child(F.Node, 1);
+
+  // Special case '=' because we don't want to emit the LHS as an expression.
+  if (Op == ASSIGN) {
+    switch (F.Step) {
+    case 0: {
+      // Assignment requires the LHS to be an identifier.
+      NodeKind LHSKind = ast.kind(LHS);
+      if (LHSKind != NODE_VARIABLE && LHSKind != NODE_ARRAY)
+        throw("destination of '=' must be a variable");
+      // Codegen the RHS.
+      return RHS;
+    }
+    case 1:
+      F.Val = pop();
+      if (!F.Val)
+        return finish(nullptr);
+      // The address of an array element needs its index first.
+      if (ast.kind(LHS) == NODE_ARRAY)
+        return ast.child(LHS, 0);
+      Builder.CreateStore(F.Val, Slots[ast.slot(LHS)]);
+      return finish(F.Val);
+    default: {
+      Builder.CreateStore(F.Val, element(ast.slot(LHS), pop()));
+      return finish(F.Val);
+    }
+    }
+  }
+
+  if (F.Step == 0)
+    return LHS;
+  if (F.Step == 1)
+    return RHS;
+  Value *R = pop();
+  Value *L = pop();
+  if (!L || !R)
+    return finish(nullptr);
+
+  switch (Op) {
+  case ADD:
+    return finish(Builder.CreateAdd(L, R, "addtmp"));
+  case SUB:
+    return finish(Builder.CreateSub(L, R, "subtmp"));
+  case MULT:
+    return finish(Builder.CreateMul(L, R, "multmp"));
+  case DIV:
+  case MOD:
+    // The IRBuilder folds a division by a constant 0, or of INT_MIN by -1,
+    // into poison. The program traps there instead, as it does when the
+    // divisor is only known at run time.
+    if (isa<ConstantInt>(R) && (cast<ConstantInt>(R)->isZero() ||
+        (cast<ConstantInt>(R)->isMinusOne() && isa<ConstantInt>(L) &&
+         cast<ConstantInt>(L)->isMinValue(true)))) {
+      Builder.CreateCall(Intrinsic::getDeclaration(TheModule.get(), Intrinsic::trap));
+      return finish(UndefValue::get(Type::getInt32Ty(TheContext)));
+    }
+    if (Op == DIV)
+      return finish(Builder.CreateSDiv(L, R, "divtmp"));
+    return finish(Builder.CreateSRem(L, R, "modtmp"));
+  case LT:
+    L = Builder.CreateICmpSLT(L, R, "lttmp");
+    break;
+  case LE:
+    L = Builder.CreateICmpSLE(L, R, "letmp");
+    break;
+  case GT:
+    L = Builder.CreateICmpSGT(L, R, "gttmp");
+    break;
+  case GE:
+    L = Builder.CreateICmpSGE(L, R, "getmp");
+    break;
+  case EQ:
+    L = Builder.CreateICmpEQ(L, R, "eqtmp");
+    break;
+  case NE:
+    L = Builder.CreateICmpNE(L, R, "netmp");
+    break;
+  case AND:
+    L = Builder.CreateICmpNE(
+                L, ConstantInt::get(TheContext, APInt(32, 0, true)), "booltmp");
+    R = Builder.CreateICmpNE(
+                R, ConstantInt::get(TheContext, APInt(32, 0, true)), "booltmp");
+    L = Builder.CreateAnd(L, R, "andtmp");
+    break;
+  case OR:
+    return finish(Builder.CreateOr(L, R, "ortmp"));
+  default:
+    throw ("Unknown operator");
+  }
+
+  // Comparisons and 'and' give an i1, widened to -1 for true.
+  return finish(Builder.CreateIntCast(L, Type::getInt32Ty(TheContext), true, "booltmp"));
+}
+
+static NodeId callStep(const Ast &ast, Frame &F)
+{
+    if (F.Step && !Values.back())
+    {
+        Values.resize(Values.size() - F.Step);
+        return finish(nullptr);
+    }
+    Ast::ChildRange Args = ast.childrenOf(F.Node);
+    if (F.Step != Args.size())
+        return Args[F.Step];
+
+    // The callee and the number of arguments were checked by resolve.
+    Function *CalleeF = cast<Function>(Slots[ast.slot(F.Node)]);
+    std::vector<Value *> ArgsV(Values.end() - Args.size(), Values.end());
+    Values.resize(Values.size() - Args.size());
+    return finish(Builder.CreateCall(CalleeF, ArgsV, "calltmp"));
+}
+
+static Value *libraryCodegen(const Ast &ast, NodeId node)
+{
+    auto ptr = Slots[ast.slot(ast.child(node, 0))];
+    auto func = Library [symbolName(ast.name(node))];
+    return Builder.CreateCall(func, ptr);
+}
+
+// Directives become attributes on routines, metadata on the back edge of
+// loops and branch weights on ifs.
+static void inlining(Function *F, const Directives *D)
+{
+    if (!D || !D->inlining)
+        return;
+    // A forward declaration may have asked for the opposite.
+    F->removeFnAttr(D->inlining > 0 ? Attribute::NoInline : Attribute::AlwaysInline);
+    F->addFnAttr(D->inlining > 0 ? Attribute::AlwaysInline : Attribute::NoInline);
+}
+
+static MDNode *loopMetadata(const Directives *D)
+{
+    if (!D || (!D->unroll && !D->vectorize))
+        return nullptr;
+    auto Hint = [](const char *Name, Constant *Value) -> Metadata * {
+        Metadata *Key = MDString::get(TheContext, Name);
+        if (!Value)
+            return MDNode::get(TheContext, Key);
+        return MDNode::get(TheContext, {Key, ConstantAsMetadata::get(Value)});
+    };
+    // The first operand of a loop id is the loop id itself.
+    TempMDTuple Self = MDNode::getTemporary(TheContext, None);
+    SmallVector<Metadata *, 4> Ops{Self.get()};
+    if (D->unroll == 1)
+        Ops.push_back(Hint("llvm.loop.unroll.disable", nullptr));
+    else if (D->unroll > 1)
+        Ops.push_back(Hint("llvm.loop.unroll.count", Builder.getInt32(D->unroll)));
+    else if (D->unroll)
+        Ops.push_back(Hint("llvm.loop.unroll.enable", nullptr));
+    if (D->vectorize)
+        Ops.push_back(Hint("llvm.loop.vectorize.enable", Builder.getInt1(D->vectorize != 1)));
+    if (D->vectorize > 1)
+        Ops.push_back(Hint("llvm.loop.vectorize.width", Builder.getInt32(D->vectorize)));
+    MDNode *Loop = MDNode::getDistinct(TheContext, Ops);
+    Loop->replaceOperandWith(0, Loop);
+    return Loop;
+}
+
+static MDNode *branchWeights(const Directives *D)
+{
+    if (!D || !D->likely)
+        return nullptr;
+    // The weights clang gives __builtin_expect.
+    MDBuilder MDB(TheContext);
+    return D->likely > 0 ? MDB.createBranchWeights(2000, 1) : MDB.createBranchWeights(1, 2000);
+}
+
+static Function *createPrototype(const std::string &Name, const std::vector<std::string> &Args)
+{
+    // Make the function type:  double(double,double) etc.
+    std::vector<Type *> Ints(Args.size(), Type::getInt32Ty(TheContext));
+    FunctionType *FT =
+        FunctionType::get(Type::getInt32Ty(TheContext), Ints, false);
+
+    Function *F =
+        Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+
+    // Set names for all arguments.
+    unsigned Idx = 0;
+    for (auto &Arg : F->args())
+        Arg.setName(Args[Idx++]);
+
+    return F;
+}
+
+static Function *prototypeCodegen(const Ast &ast, NodeId node)
+{
+    std::vector<std::string> Args;
+    for (NodeId arg : ast.childrenOf(node))
+        Args.push_back(symbolName(ast.name(arg)));
+    Function *F = createPrototype(symbolName(ast.name(node)), Args);
+    inlining(F, ast.directives(node));
+    Slots[ast.slot(node)] = F;
+    return F;
+}
+
+static NodeId functionStep(const Ast &ast, Frame &F)
+{
+    // The prototype comes first, the body follows.
+    std::size_t Size = ast.childCount(F.Node);
+    if (F.Step) {
+        Value *V = pop();
+        if (F.Step != Size - 1)
+            return ast.child(F.Node, F.Step + 1);
+
+        Function *TheFunction = cast<Function>(F.Val);
+        if (!V) {
+            // Error reading body, remove function.
+            TheFunction->eraseFromParent();
+            return finish(nullptr);
+        }
+        Builder.CreateBr(F.BB[0]);
+        // Finish off the function.
+        Builder.SetInsertPoint(F.BB[0]);
+        Builder.CreateRet(V);
+
+        // Validate the generated code, checking for consistency.
+        verifyFunction(*TheFunction);
+
+        Builder.SetInsertPoint(mainBlock);
+        return finish(TheFunction);
+    }
+
+    NodeId Proto = ast.child(F.Node, 0);
+    // First, check for an existing function from a previous 'forward' declaration.
+    Function *TheFunction = cast_or_null<Function>(Slots[ast.slot(Proto)]);
+
+    if (!TheFunction)
+        TheFunction = prototypeCodegen(ast, Proto);
+    inlining(TheFunction, ast.directives(F.Node));
+
+    // Create a new basic block to start insertion into.
+    BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
+    Builder.SetInsertPoint(BB);
+
+    // Record the function arguments in their slots.
+    Ast::ChildRange Params = ast.childrenOf(Proto);
+    for (auto &Arg : TheFunction->args())
+    {
+        // Create an alloca for this variable.
+        Value *Alloca = CreateEntryBlockAlloca(TheFunction, Arg.getName().str());
+
+        // Store the initial value int o the alloca.
+        Builder.CreateStore(&Arg, Alloca);
+
+        Slots[ast.slot(Params[Arg.getArgNo()])] = Alloca;
+    }
+
+    F.Val = TheFunction;
+    F.BB[0] = BasicBlock::Create(TheContext, "return", TheFunction);
+    return ast.child(F.Node, 1);
+}
+
+static Value *returnCodegen(const Ast &ast, NodeId node)
+{
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    // The slot of the function result, procedures and main have none.
+    Value *Ret;
+    if (ast.slot(node) != NO_SLOT)
+        Ret = Builder.CreateLoad(Builder.getInt32Ty(), Slots[ast.slot(node)]);
+    else
+        Ret = ConstantInt::get(TheContext, APInt(32, 0, true));
+    Builder.CreateRet(Ret);
+    BasicBlock *Cont = BasicBlock::Create(TheContext, "dunno", TheFunction);
+    Builder.SetInsertPoint(Cont);
+    return ConstantInt::get(TheContext, APInt(32, 0, true));
+}
+
+// Output for-loop as a guarded counted loop, the bounds evaluated once:
+//   start = startexpr
+//   end = endexpr
+//   store start -> var
+//   br start <= end (>= for downto), loop, afterloop
+// loop:
+//   bodyexpr
+//   curvar = load var
+//   br curvar >= end (<= for downto), afterloop, forinc
+// forinc:
+//   nextvar = add nsw curvar, 1 (sub nsw for downto)
+//   store nextvar -> var
+//   br loop
+// afterloop:
+// The body may assign the variable, so the loop leaves once the variable
+// reaches or passes end, not only when it equals it. The step is taken only
+// while the variable is before end, so it can not overflow and is nsw. A loop
+// which runs to the end leaves the variable at end, an empty one at start.
+static NodeId forStep(const Ast &ast, Frame &F) {
+  // Emit the start code first, then the end and the body.
+  if (F.Step == 0)
+    return ast.child(F.Node, 0);
+  if (F.Step == 1)
+    return Values.back() ? ast.child(F.Node, 1) : finish(pop());
+
+  // The loop variable is an ordinary variable declared before.
+  Value *Alloca = Slots[ast.slot(F.Node)];
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock *&LoopBB = F.BB[0], *&AfterBB = F.BB[1];
+  int Step = ast.value(ast.child(F.Node, 2));
+
+  if (F.Step == 2) {
+    Value *EndVal = pop();
+    Value *StartVal = pop();
+    if (!EndVal)
+      return finish(nullptr);
+
+    // Store the value into the alloca.
+    Builder.CreateStore(StartVal, Alloca);
+
+    // Skip the loop when the range is empty.
+    Value *Guard = Step > 0 ? Builder.CreateICmpSLE(StartVal, EndVal, "forguard")
+                            : Builder.CreateICmpSGE(StartVal, EndVal, "forguard");
+    LoopBB = BasicBlock::Create(TheContext, "loop", TheFunction);
+    AfterBB = BasicBlock::Create(TheContext, "afterloop");
+    Builder.CreateCondBr(Guard, LoopBB, AfterBB);
+
+    // Start insertion in LoopBB.
+    Builder.SetInsertPoint(LoopBB);
+
+    // Emit the body of the loop.  This, like any other expr, can change the
+    // current BB.  Note that we ignore the value computed by the body, but don't
+    // allow an error.
+    F.Val = EndVal;
+    return ast.child(F.Node, 3);
+  }
+  if (!pop())
+    return finish(nullptr);
+
+  // Leave after the pass with the variable at or past end.  This reloads the
+  // variable in case the body of the loop mutates it.
+  Value *CurVar = Builder.CreateLoad(Builder.getInt32Ty(), Alloca, symbolName(ast.name(F.Node)));
+  Value *EndCond = Step > 0 ? Builder.CreateICmpSGE(CurVar, F.Val, "fordone")
+                            : Builder.CreateICmpSLE(CurVar, F.Val, "fordone");
+  BasicBlock *IncBB = BasicBlock::Create(TheContext, "forinc", TheFunction);
+  Builder.CreateCondBr(EndCond, AfterBB, IncBB);
+
+  // Increment and restore the alloca.
+  Builder.SetInsertPoint(IncBB);
+  Value *One = ConstantInt::get(TheContext, APInt(32, 1, true));
+  Value *NextVar = Step > 0 ? Builder.CreateNSWAdd(CurVar, One, "nextvar")
+                            : Builder.CreateNSWSub(CurVar, One, "nextvar");
+  Builder.CreateStore(NextVar, Alloca);
+  Builder.CreateBr(LoopBB)->setMetadata(LLVMContext::MD_loop,
+                                        loopMetadata(ast.directives(F.Node)));
+
+  // Any new code will be inserted in AfterBB.
+  TheFunction->getBasicBlockList().push_back(AfterBB);
+  Builder.SetInsertPoint(AfterBB);
+
+  // for expr always returns 0.
+  return finish(Constant::getNullValue(Type::getInt32Ty(TheContext)));
+}
+
+static NodeId ifStep(const Ast &ast, Frame &F) {
+  if (F.Step == 0)
+    return ast.child(F.Node, 0);
+  if (!Values.back()) {
+    pop();
+    // The value of the then branch is kept below the failed one.
+    if (F.Step == 3)
+      pop();
+    return finish(nullptr);
+  }
+
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock *&ThenBB = F.BB[0], *&ElseBB = F.BB[1], *&MergeBB = F.BB[2];
+
+  switch (F.Step) {
+  case 1: {
+    // Convert condition to a bool by comparing non-equal to 0.0.
+    Value *CondV = Builder.CreateICmpNE(
+        pop(), ConstantInt::get(TheContext, APInt(32, 0, true)), "ifcond");
+
+    // Create blocks for the then and else cases.  Insert the 'then' block at the
+    // end of the function.
+    ThenBB = BasicBlock::Create(TheContext, "then", TheFunction);
+    ElseBB = BasicBlock::Create(TheContext, "else");
+    MergeBB = BasicBlock::Create(TheContext, "ifcont");
+
+    Builder.CreateCondBr(CondV, ThenBB, ElseBB,
+                         branchWeights(ast.directives(F.Node)));
+
+    // Emit then value.
+    Builder.SetInsertPoint(ThenBB);
+    return ast.child(F.Node, 1);
+  }
+  case 2:
+    // The value of the then branch stays on Values for the PHI.
+    Builder.CreateBr(MergeBB);
+    // Codegen of 'Then' can change the current block, update ThenBB for the PHI.
+    ThenBB = Builder.GetInsertBlock();
+
+    // Emit else block.
+    TheFunction->getBasicBlockList().push_back(ElseBB);
+    Builder.SetInsertPoint(ElseBB);
+    return ast.child(F.Node, 2);
+  }
+
+  Value *ElseV = pop();
+  Value *ThenV = pop();
+  Builder.CreateBr(MergeBB);
+  // Codegen of 'Else' can change the current block, update ElseBB for the PHI.
+  ElseBB = Builder.GetInsertBlock();
+
+  // Emit merge block.
+  TheFunction->getBasicBlockList().push_back(MergeBB);
+  Builder.SetInsertPoint(MergeBB);
+  PHINode *PN = Builder.CreatePHI(Type::getInt32Ty(TheContext), 2, "iftmp");
+
+  PN->addIncoming(ThenV, ThenBB);
+  PN->addIncoming(ElseV, ElseBB);
+  return finish(PN);
+}
+
+static NodeId whileStep(const Ast &ast, Frame &F)
+{
+  Function *TheFunction = Builder.GetInsertBlock()->getParent();
+  BasicBlock *&CondBB = F.BB[0], *&LoopBB = F.BB[1], *&ExitBB = F.BB[2];
+
+  if (F.Step == 0) {
+    // Make the new basic block for the loop header, inserting after current
+    // block.
+    CondBB = BasicBlock::Create(TheContext, "cond", TheFunction);
+    // Create blocks for the body and exit.  Insert the 'cond' block at the
+    // end of the function.
+    LoopBB = BasicBlock::Create(TheContext, "loop");
+    ExitBB = BasicBlock::Create(TheContext, "exit");
+
+    // Insert an explicit fall through from the current block to the LoopBB.
+    Builder.CreateBr(CondBB);
+
+    // Start insertion in LoopBB.
+    Builder.SetInsertPoint(CondBB);
+    return ast.child(F.Node, 0);
+  }
+  Value *V = pop();
+  if (!V)
+    return finish(nullptr);
+
+  if (F.Step == 1) {
+    // Convert condition to a bool by comparing non-equal to 0.0.
+    Value *CondV = Builder.CreateICmpNE(
+        V, ConstantInt::get(TheContext, APInt(32, 0, true)), "ifcond");
+
+
+    Builder.CreateCondBr(CondV, LoopBB, ExitBB);
+
+    // Emit then value.
+    TheFunction->getBasicBlockList().push_back(LoopBB);
+    Builder.SetInsertPoint(LoopBB);
+    return ast.child(F.Node, 1);
+  }
+  Builder.CreateBr(CondBB)->setMetadata(LLVMContext::MD_loop,
+                                        loopMetadata(ast.directives(F.Node)));
+
+  TheFunction->getBasicBlockList().push_back(ExitBB);
+  Builder.SetInsertPoint(ExitBB);
+
+  return finish(Constant::getNullValue(Type::getInt32Ty(TheContext)));
+}
+
+static NodeId programStep(const Ast &ast, Frame &F)
+{
+    switch (F.Step) {
+    case 0:
+        Builder.SetInsertPoint(mainBlock);
+        Slots.assign(ast.slotCount(), nullptr);
+        Offsets.assign(ast.slotCount(), 0);
+
+        // Generate prototypes
+        Slots[SLOT_PRINTI] = createPrototype("printi", {"x"});
+        Slots[SLOT_WRITELN] = createPrototype("writeln", {"x"});
+        for (const char *Name : {"dec", "inc"})
+            createPrototype(Name, {"x"});
+
+        Builder.SetInsertPoint(mainBlock);
+        return ast.child(F.Node, 0);
+    case 1:
+        pop();
+        Builder.SetInsertPoint(mainBlock);
+        return ast.child(F.Node, 1);
+    }
+    pop();
+
+    // Create return
+    Builder.CreateRet(ConstantInt::get(TheContext, APInt(32, 0, true)));
+    return finish(main_func);
+}
+
+/// step - Next step of the node of the frame.
+static NodeId step ( const Ast & ast, Frame & F )
+{
+    NodeId node = F . Node;
+    switch ( ast . kind ( node ) )
+    {
+        case NODE_PROGRAM:      return programStep ( ast, F );
+        case NODE_LIST:         return listStep ( ast, F );
+        case NODE_NUMBER:       return finish ( numberCodegen ( ast, node ) );
+        case NODE_CONST:        return finish ( constCodegen ( ast, node ) );
+        case NODE_DECLARE:      return finish ( declareCodegen ( ast, node ) );
+        case NODE_VARIABLE:     return finish ( variableCodegen ( ast, node ) );
+        case NODE_ARRAY:        return arrayStep ( ast, F );
+        case NODE_BINARY:       return binaryStep ( ast, F );
+        case NODE_IF:           return ifStep ( ast, F );
+        case NODE_FOR:          return forStep ( ast, F );
+        case NODE_WHILE:        return whileStep ( ast, F );
+        case NODE_CALL:         return callStep ( ast, F );
+        case NODE_LIBRARY:      return finish ( libraryCodegen ( ast, node ) );
+        case NODE_RETURN:       return finish ( returnCodegen ( ast, node ) );
+        case NODE_PROTOTYPE:    return finish ( prototypeCodegen ( ast, node ) );
+        case NODE_FUNCTION:     return functionStep ( ast, F );
+        default:                throw ( "Unknown node kind" );
+    }
+}
+
+Value * mila::codegen ( const Ast & ast, NodeId node )
+{
+    Values . clear ();
+    std::vector < Frame > frames;
+    frames . push_back ( Frame { node, 0, nullptr, {} } );
+    while ( !frames . empty () )
+    {
+        NodeId child = step ( ast, frames . back () );
+        if ( child == Done )
+            frames . pop_back ();
+        else
+        {
+            frames . back () . Step ++;
+            frames . push_back ( Frame { child, 0, nullptr, {} } );
+        }
+    }
+    return pop ();
+}
+
+//===----------------------------------------------------------------------===//
+// Optimization
+//===----------------------------------------------------------------------===//
+
+// The host is the target. Its machine is made once, the module gets its triple
+// and data layout before any pass runs, so the optimizer sees the real costs
+// and the object code matches what it assumed.
+static TargetMachine *hostMachine()
+{
+    static std::unique_ptr<TargetMachine> Machine;
+    if (!Machine) {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        std::string Triple = sys::getDefaultTargetTriple(), Error;
+        const Target *TheTarget = TargetRegistry::lookupTarget(Triple, Error);
+        if (!TheTarget)
+            throw("No target for the host");
+        // Position independent, the system compiler links PIE by default.
+        Machine.reset(TheTarget->createTargetMachine(Triple, sys::getHostCPUName(), "",
+                                                     TargetOptions(), Reloc::PIC_));
+    }
+    TheModule->setTargetTriple(Machine->getTargetTriple().str());
+    TheModule->setDataLayout(Machine->createDataLayout());
+    return Machine.get();
+}
+
+// The new pass manager runs the same pipelines as clang: mem2reg and SROA turn
+// the allocas of the variables into registers, then instcombine, GVN, the loop
+// passes and the inliner work on the result.
+
+void mila::optimize ( unsigned level )
+{
+    if ( !level )
+        return;
+#if LLVM_VERSION_MAJOR >= 14
+    OptimizationLevel Levels [] = {
+        OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3 };
+#else
+    PassBuilder::OptimizationLevel Levels [] = {
+        PassBuilder::O1, PassBuilder::O2, PassBuilder::O3 };
+#endif
+
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PassBuilder PB(hostMachine());
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(Levels[std::min(level, 3u) - 1]);
+    MPM.run(*TheModule, MAM);
+}
+
+void mila::emitObject ( const std::string & file, unsigned level )
+{
+    TargetMachine *Machine = hostMachine();
+    CodeGenOpt::Level Levels [] = {
+        CodeGenOpt::None, CodeGenOpt::Less, CodeGenOpt::Default, CodeGenOpt::Aggressive };
+    Machine->setOptLevel(Levels[std::min(level, 3u)]);
+
+    std::error_code EC;
+    raw_fd_ostream Out(file, EC, FILE_NONE);
+    if (EC)
+        throw("Could not open the object file");
+    legacy::PassManager PM;
+#if LLVM_VERSION_MAJOR >= 10
+    if (Machine->addPassesToEmitFile(PM, Out, nullptr, CGFT_ObjectFile))
+#elif LLVM_VERSION_MAJOR >= 7
+    if (Machine->addPassesToEmitFile(PM, Out, nullptr, TargetMachine::CGFT_ObjectFile))
+#else
+    if (Machine->addPassesToEmitFile(PM, Out, TargetMachine::CGFT_ObjectFile))
+#endif
+        throw("The host target can not emit object files");
+    PM.run(*TheModule);
+}
+
+//#######################################################################################
+
+/// CreateEntryBlockAlloca - Create an alloca instruction in the entry block of
+/// the function.  This is used for mutable variables etc, i32 unless Ty is
+/// given.
+AllocaInst * mila::CreateEntryBlockAlloca(Function *TheFunction,
+                                          const std::string &VarName,
+                                          Type *Ty)
+{
+    IRBuilder<> TmpB(&TheFunction->getEntryBlock(),
+            TheFunction->getEntryBlock().begin());
+    return TmpB.CreateAlloca(Ty ? Ty : Type::getInt32Ty(TheContext), 0,
+            VarName.c_str());
+}
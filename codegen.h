@@ -0,0 +1,61 @@
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "llvm/IR/Verifier.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+using namespace llvm;
+
+#ifndef MILA_CODEGEN_H
+#define MILA_CODEGEN_H
+
+// The code was written for LLVM 6 and also builds with later releases, the
+// few APIs which changed on the way are picked by LLVM_VERSION_MAJOR.
+#if LLVM_VERSION_MAJOR >= 9
+#define FILE_NONE sys::fs::OF_None
+#else
+#define FILE_NONE sys::fs::F_None
+#endif
+
+namespace mila
+{
+    /// codegen - Emit the IR of the subtree rooted at node into TheModule.
+    /// A program node generates the whole main function.
+    Value * codegen ( const Ast & ast, NodeId node );
+
+    /// optimize - Run the default LLVM pipeline of -O level, 1 to 3, over
+    /// TheModule. Level 0 leaves the code as codegen made it.
+    void optimize ( unsigned level );
+
+    /// emitObject - Write TheModule as an object file for the host, with
+    /// the code generator at -O level.
+    void emitObject ( const std::string & file, unsigned level );
+
+    AllocaInst *CreateEntryBlockAlloca(Function *TheFunction,
+                                          const std::string &VarName,
+                                          Type *Ty = nullptr);
+
+    extern LLVMContext TheContext;
+    extern IRBuilder<> Builder;
+    extern std::unique_ptr<Module> TheModule;
+    /// Value of every slot the names were resolved to: the constant, the
+    /// address of a variable or the function of a routine.
+    extern std::vector<Value *> Slots;
+    extern std::map<std::string, Function *> Library;
+    extern Function *main_func;
+    extern BasicBlock *mainBlock;
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include "parser.h"
+#include "codegen.h"
+#include "lexan.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <sys/resource.h>
+
+using namespace mila;
+using namespace std;
+
+//==========================================================================
+struct Options
+{
+    int scale = 1;
+    int routines = 10;
+    int variables = 4;
+    int depth = 3;
+    int operands = 4;
+    int arrays = 1;
+    int nesting = 0;
+    unsigned seed = 1;
+    unsigned jobs = 1;
+    const char * dump = nullptr;
+};
+
+/// Generator - Valid program whose size grows linearly with the scale. Each
+/// of the scale * routines routines has the given numbers of local integers
+/// and arrays, statements nest up to depth and expressions have up to
+/// operands operands. Every fourth routine is a procedure, the rest are
+/// functions, calls only go to routines defined before and main calls each
+/// of them once. Names are the parameters, locals and a few global
+/// constants, so codegen accepts the result.
+class Generator
+{
+    public:
+        Generator ( const Options & opt ) : opt ( opt ), rng ( opt . seed ) {}
+
+        string program ( void )
+        {
+            if ( opt . nesting )
+                return nested ( opt . nesting );
+            int routines = opt . scale * opt . routines;
+            os << "program scaled;\nconst c0 = 7; c1 = $ff; c2 = &17; c3 = 0x1F;\n";
+            for ( int r = 0 ; r < routines ; r ++ )
+                routine ( r );
+            os << "var x : integer;\nbegin\n    x := 0;\n";
+            for ( int r = 0 ; r < routines ; r ++ )
+                if ( procedure ( r ) )
+                    os << "    p" << r << " ( x, " << r << " );\n";
+                else
+                    os << "    x := f" << r << " ( x, " << r << " );\n";
+            os << "    writeln ( x )\nend.\n";
+            return os . str ();
+        }
+
+    private:
+        /// nested - Main block only, each statement nests depth deep: an
+        /// expression in parentheses, a right leaning sum, ifs in the else
+        /// blocks of ifs and loops in the blocks of loops.
+        string nested ( int depth )
+        {
+            os << "program nested;\nvar x : integer;\nbegin\n    x := ";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << "( ";
+            os << 1;
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << " )";
+            os << ";\n    x := ";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << "x + ( ";
+            os << "x";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << " )";
+            os << ";\n    ";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << "if x < " << i << " then x := " << i << " else begin ";
+            os << "x := 1";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << " end";
+            os << ";\n    ";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << "while x < " << i << " do begin ";
+            os << "inc ( x )";
+            for ( int i = 0 ; i < depth ; i ++ )
+                os << " end";
+            os << ";\n    writeln ( x )\nend.\n";
+            return os . str ();
+        }
+
+        static bool procedure ( int r )
+        {
+            return r % 4 == 3;
+        }
+
+        void routine ( int r )
+        {
+            defined = r;
+            if ( procedure ( r ) )
+                os << "procedure p" << r << " ( a : integer; b : integer );\n";
+            else
+                os << "function f" << r << " ( a : integer; b : integer ) : integer;\n";
+            if ( opt . variables > 0 || opt . arrays > 0 )
+            {
+                os << "var";
+                for ( int v = 0 ; v < opt . variables ; v ++ )
+                    os << " l" << v << " : integer;";
+                for ( int v = 0 ; v < opt . arrays ; v ++ )
+                    os << " v" << v << " : array [0 .. 15] of integer;";
+                os << "\n";
+            }
+            os << "begin\n";
+            for ( int s = 2 + rng () % 4 ; s > 0 ; s -- )
+            {
+                statement ( 1 );
+                os << ";\n";
+            }
+            if ( procedure ( r ) )
+                os << "    writeln ( a )\nend;\n";
+            else
+                os << "    f" << r << " := a\nend;\n";
+        }
+
+        void scalar ( void )
+        {
+            int choices = 2 + opt . variables;
+            int pick = rng () % choices;
+            if ( pick < 2 )
+                os << "ab" [ pick ];
+            else
+                os << "l" << pick - 2;
+        }
+
+        void operand ( int depth )
+        {
+            switch ( rng () % ( depth < 2 ? 7 : 4 ) )
+            {
+                case 0:  os << rng () % 1000; break;
+                case 1:  os << "c" << rng () % 4; break;
+                case 2:
+                case 3:  scalar (); break;
+                case 4:
+                    if ( !opt . arrays )
+                    {
+                        scalar ();
+                        break;
+                    }
+                    os << "v" << rng () % opt . arrays << " [ ( ";
+                    expression ( depth + 1 );
+                    os << " ) mod 16 ]";
+                    break;
+                case 5:  os << "( "; expression ( depth + 1 ); os << " )"; break;
+                default:
+                {
+                    // one of the last functions before this routine, if there is one
+                    int callee = defined - 1 - int ( rng () % 8 );
+                    while ( callee >= 0 && procedure ( callee ) )
+                        callee --;
+                    if ( callee < 0 )
+                    {
+                        scalar ();
+                        break;
+                    }
+                    os << "f" << callee << " ( ";
+                    expression ( depth + 1 );
+                    os << ", ";
+                    expression ( depth + 1 );
+                    os << " )";
+                }
+            }
+        }
+
+        void expression ( int depth )
+        {
+            static const char * operators [] = { "+", "-", "*", "div", "mod", "<", ">", "=", "<>", "and", "or" };
+            operand ( depth );
+            for ( int n = rng () % opt . operands ; n > 0 ; n -- )
+            {
+                os << ' ' << operators [ rng () % 11 ] << ' ';
+                operand ( depth );
+            }
+        }
+
+        void indent ( int depth )
+        {
+            os << string ( 4 * depth, ' ' );
+        }
+
+        void block ( int depth )
+        {
+            os << "begin\n";
+            for ( int s = 1 + rng () % 3 ; s > 0 ; s -- )
+            {
+                statement ( depth + 1 );
+                os << ";\n";
+            }
+            indent ( depth + 1 );
+            os << "inc ( a )\n";
+            indent ( depth );
+            os << "end";
+        }
+
+        void target ( void )
+        {
+            if ( opt . arrays && rng () % 3 == 0 )
+            {
+                os << "v" << rng () % opt . arrays << " [ b mod 16 ]";
+                return;
+            }
+            int pick = rng () % ( 1 + opt . variables );
+            if ( pick )
+                os << "l" << pick - 1;
+            else
+                os << "b";
+        }
+
+        void statement ( int depth )
+        {
+            indent ( depth );
+            switch ( depth <= opt . depth ? rng () % 7 : rng () % 3 )
+            {
+                case 0:
+                case 1:
+                    target ();
+                    os << " := ";
+                    expression ( 0 );
+                    break;
+                case 2:
+                    os << "writeln ( ";
+                    expression ( 0 );
+                    os << " )";
+                    break;
+                case 3:
+                    os << "if ";
+                    expression ( 0 );
+                    os << " then ";
+                    block ( depth );
+                    os << " else ";
+                    block ( depth );
+                    break;
+                case 4:
+                    os << "for b := 0 to ";
+                    expression ( 0 );
+                    os << " do ";
+                    block ( depth );
+                    break;
+                case 5:
+                    os << "while a < ";
+                    expression ( 0 );
+                    os << " do ";
+                    block ( depth );
+                    break;
+                default:
+                    // an earlier procedure, if any
+                    for ( int callee = defined - 1 ; callee >= 0 && callee >= defined - 4 ; callee -- )
+                        if ( procedure ( callee ) )
+                        {
+                            os << "p" << callee << " ( ";
+                            expression ( 0 );
+                            os << ", b )";
+                            return;
+                        }
+                    os << "dec ( a )";
+            }
+        }
+
+        const Options & opt;
+        mt19937 rng;
+        ostringstream os;
+        int defined = 0;
+};
+
+/// Peak resident set size of the process so far, in kilobytes.
+static long peakKilobytes ( void )
+{
+    struct rusage usage;
+    getrusage ( RUSAGE_SELF, &usage );
+    return usage . ru_maxrss;
+}
+
+template < class F >
+static double timed ( F run )
+{
+    auto begin = chrono::steady_clock::now ();
+    run ();
+    return chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+}
+
+static void usage ( const char * self )
+{
+    cerr << "usage: " << self << " [-x scale] [-f routines] [-v variables] [-d depth] [-e operands]"
+         << " [-a arrays] [-n depth] [-s seed] [-j threads] [-g file]" << endl
+         << "  -n generates only a main block nesting depth deep instead" << endl
+         << "  prints one line: scale or depth, routines, bytes, symbols, nodes, then seconds and ns/byte"
+         << " of lex, parse, fold and codegen, then AST bytes and peak RSS in kB after each phase" << endl;
+    exit ( 1 );
+}
+
+int main ( int argc, char ** argv )
+{
+    Options opt;
+    for ( int i = 1 ; i < argc ; i ++ )
+    {
+        if ( argv [ i ] [ 0 ] != '-' || i + 1 == argc )
+            usage ( argv [ 0 ] );
+        const char * arg = argv [ ++ i ];
+        switch ( argv [ i - 1 ] [ 1 ] )
+        {
+            case 'x': opt . scale = atoi ( arg ); break;
+            case 'f': opt . routines = atoi ( arg ); break;
+            case 'v': opt . variables = atoi ( arg ); break;
+            case 'd': opt . depth = atoi ( arg ); break;
+            case 'e': opt . operands = max ( 1, atoi ( arg ) ); break;
+            case 'a': opt . arrays = atoi ( arg ); break;
+            case 'n': opt . nesting = atoi ( arg ); break;
+            case 's': opt . seed = atoi ( arg ); break;
+            case 'j': opt . jobs = atoi ( arg ); break;
+            case 'g': opt . dump = arg; break;
+            default: usage ( argv [ 0 ] );
+        }
+    }
+
+    string source = Generator ( opt ) . program ();
+    if ( opt . dump )
+    {
+        ofstream ( opt . dump ) << source;
+        return 0;
+    }
+    long generated = peakKilobytes ();
+
+    try
+    {
+        // Lexing on its own, the parser lexes again as it goes.
+        size_t symbols = 0;
+        double lexing = timed ( [&]
+        {
+            istringstream is ( source );
+            SourceBuffer buffer ( is );
+            Lexan lex ( move ( buffer ) );
+            LexicalSymbol ls;
+            while ( !lex . eof () )
+            {
+                lex >> ls;
+                if ( ls . type == ERROR )
+                    throw "The generated program does not lex.";
+                symbols ++;
+            }
+        } );
+        long lexed = peakKilobytes ();
+
+        istringstream is ( source );
+        SourceBuffer buffer ( is );
+        Parser parser ( Lexan ( move ( buffer ) ), opt . jobs );
+        NodeId program = 0;
+        double parsing = timed ( [&] { program = parser . parseProgram (); } );
+        long parsed = peakKilobytes ();
+
+        Ast & ast = parser . tree ();
+        double folding = timed ( [&] { fold ( ast ); } );
+
+        // Codegen fills the one global module, so one scale per process.
+        double generating = timed ( [&] { codegen ( ast, program ); } );
+        long generatedCode = peakKilobytes ();
+
+        double bytes = source . size ();
+        cout << fixed << setprecision ( 4 )
+             << ( opt . nesting ? opt . nesting : opt . scale ) << ' ' << ( opt . nesting ? 0 : opt . scale * opt . routines )
+             << ' ' << source . size () << ' ' << symbols << ' '
+             << ast . size () << ' '
+             << lexing << ' ' << lexing / bytes * 1e9 << ' '
+             << parsing << ' ' << parsing / bytes * 1e9 << ' '
+             << folding << ' ' << folding / bytes * 1e9 << ' '
+             << generating << ' ' << generating / bytes * 1e9 << ' '
+             << ast . bytes () << ' ' << generated << ' ' << lexed << ' ' << parsed << ' ' << generatedCode << endl;
+    }
+    catch ( ParserException & e )
+    {
+        cerr << e << endl;
+        return 1;
+    }
+    catch ( const char * e )
+    {
+        cerr << e << endl;
+        return 1;
+    }
+    return 0;
+}
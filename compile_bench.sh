@@ -0,0 +1,18 @@
+#!/bin/bash
+# Times lexing, parsing, folding and codegen of generated programs at 1x, 10x, 100x
+# and 1000x the base size, one process per scale. The ns/byte columns should
+# stay flat, one that grows with the scale is a superlinear hot spot. Any
+# arguments go to compile_bench, e.g. -f 20 -d 4 -e 8.
+
+printf "%6s %8s %10s %9s %9s | %9s %7s | %9s %7s | %9s %7s | %9s %7s | %10s %9s\n" \
+    scale routines bytes symbols nodes lex ns/B parse ns/B fold ns/B codegen ns/B "ast bytes" "peak kB"
+for scale in 1 10 100 1000
+do
+if ! row=$(./compile_bench -x $scale "$@")
+then
+echo "compile_bench failed at ${scale}x" >&2
+exit 1
+fi
+echo "$row" | awk '{ printf "%5dx %8d %10d %9d %9d | %9.4f %7.2f | %9.4f %7.2f | %9.4f %7.2f | %9.4f %7.2f | %10d %9d\n",
+    $1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14, $18 }'
+done
@@ -1,12 +1,12 @@
 #!/bin/bash
 
 i=0
-for file in samples/*
+for file in samples/*.p
 do
 printf '%d: %s\n' $((++i)) "$file"
 cat "$file"
 echo
-if ! ./generate.sh "$file"
+if ! bash generate.sh "$file"
 then
 exit 1
 else
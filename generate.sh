@@ -1,15 +1,16 @@
 #! /bin/bash
 
+# With a second argument it is the name of the program in the sample, the
+# parser writes the bitcode, llc and gcc make the executable of it. Otherwise
+# the parser emits and links binary/a.out itself.
 if [ $# -gt 1 ]
 then
 name=$2
-else
-name=${1##*/}
-name=${name%%.p}
-fi
-#echo $name
 ./parser < "${1}" &&
 llc binary/"$name" -filetype=obj -o binary/"$name".o &&
 gcc binary/"$name".o binary/inc.o -o binary/a.out &&
-binary/a.out 
-
+binary/a.out
+else
+./parser -o binary/a.out < "${1}" &&
+binary/a.out
+fi
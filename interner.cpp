@@ -0,0 +1,156 @@
+#include "interner.h"
+#include <string>
+#include <deque>
+#include <vector>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+
+using namespace mila;
+
+namespace
+{
+    /// Interner - Open addressing hash table over a stable list of names.
+    /// Looking up an already known name does not allocate. Ids are local
+    /// to the table; index 0 is reserved for the empty string.
+    class Interner
+    {
+        public:
+            Interner ( void );
+            SymbolId intern ( const char *, std::size_t, std::uint32_t );
+            const std::string & name ( SymbolId ) const;
+            static std::uint32_t hash ( const char *, std::size_t );
+
+        private:
+            void grow ( void );
+            struct Slot
+            {
+                std::uint32_t hash;
+                SymbolId id;
+            };
+            static const SymbolId EMPTY = ~SymbolId ( 0 );
+            std::deque < std::string > names;
+            std::vector < Slot > slots;
+    };
+
+    /// Shard - One lock-protected part of the symbol table. Names are
+    /// spread over the shards by hash so that threads lexing different
+    /// parts of a file rarely wait on each other.
+    struct Shard
+    {
+        std::mutex lock;
+        Interner table;
+    };
+
+    const unsigned SHARD_BITS = 4;
+
+    /// Number of live ConcurrentInterning. Threads are started after it
+    /// goes up and joined before it goes down, which orders it with their
+    /// work, so it is read relaxed.
+    std::atomic < unsigned > concurrent ( 0 );
+
+    Shard & shard ( std::size_t index )
+    {
+        static Shard shards [ 1 << SHARD_BITS ];
+        return shards [ index ];
+    }
+}
+
+const SymbolId Interner::EMPTY;
+
+Interner::Interner ( void )
+: slots ( 1024, Slot { 0, EMPTY } )
+{
+    intern ( "", 0, hash ( "", 0 ) );
+}
+
+std::uint32_t Interner::hash ( const char * str, std::size_t length )
+{
+    // FNV-1a
+    std::uint32_t h = 2166136261u;
+    for ( std::size_t i = 0 ; i < length ; i ++ )
+        h = ( h ^ static_cast < unsigned char > ( str [ i ] ) ) * 16777619u;
+    return h;
+}
+
+SymbolId Interner::intern ( const char * str, std::size_t length, std::uint32_t h )
+{
+    std::size_t mask = slots . size () - 1;
+    for ( std::size_t i = h & mask ; ; i = ( i + 1 ) & mask )
+    {
+        const Slot & slot = slots [ i ];
+        if ( slot . id == EMPTY )
+        {
+            SymbolId id = names . size ();
+            names . emplace_back ( str, length );
+            slots [ i ] = Slot { h, id };
+            if ( 2 * names . size () > slots . size () )
+                grow ();
+            return id;
+        }
+        if ( slot . hash == h )
+        {
+            const std::string & name = names [ slot . id ];
+            if ( name . size () == length && !memcmp ( name . data (), str, length ) )
+                return slot . id;
+        }
+    }
+}
+
+const std::string & Interner::name ( SymbolId id ) const
+{
+    return names [ id ];
+}
+
+void Interner::grow ( void )
+{
+    std::vector < Slot > bigger ( 2 * slots . size (), Slot { 0, EMPTY } );
+    std::size_t mask = bigger . size () - 1;
+    for ( const Slot & slot : slots )
+    {
+        if ( slot . id == EMPTY )
+            continue;
+        std::size_t i = slot . hash & mask;
+        while ( bigger [ i ] . id != EMPTY )
+            i = ( i + 1 ) & mask;
+        bigger [ i ] = slot;
+    }
+    slots . swap ( bigger );
+}
+//==========================================================================
+SymbolId mila::intern ( const char * str, std::size_t length )
+{
+    if ( !length )
+        return 0;
+    std::uint32_t h = Interner::hash ( str, length );
+    std::size_t index = h >> ( 32 - SHARD_BITS );
+    Shard & s = shard ( index );
+    if ( !concurrent . load ( std::memory_order_relaxed ) )
+        return ( s . table . intern ( str, length, h ) << SHARD_BITS ) | index;
+    std::lock_guard < std::mutex > guard ( s . lock );
+    return ( s . table . intern ( str, length, h ) << SHARD_BITS ) | index;
+}
+
+SymbolId mila::intern ( const std::string & str )
+{
+    return intern ( str . data (), str . size () );
+}
+
+const std::string & mila::symbolName ( SymbolId id )
+{
+    Shard & s = shard ( id & ( ( 1 << SHARD_BITS ) - 1 ) );
+    if ( !concurrent . load ( std::memory_order_relaxed ) )
+        return s . table . name ( id >> SHARD_BITS );
+    std::lock_guard < std::mutex > guard ( s . lock );
+    return s . table . name ( id >> SHARD_BITS );
+}
+
+mila::ConcurrentInterning::ConcurrentInterning ( void )
+{
+    concurrent ++;
+}
+
+mila::ConcurrentInterning::~ConcurrentInterning ( void )
+{
+    concurrent --;
+}
@@ -0,0 +1,33 @@
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef MILA_INTERNER_H
+#define MILA_INTERNER_H
+
+namespace mila
+{
+    /// SymbolId - Compact handle of an interned string. Equal strings always
+    /// get the same id, so names compare as integers. Id 0 is the empty string.
+    /// Interning and looking up names is safe from several threads at once
+    /// while a ConcurrentInterning exists.
+    typedef std::uint32_t SymbolId;
+
+    SymbolId intern ( const char *, std::size_t );
+    SymbolId intern ( const std::string & );
+    const std::string & symbolName ( SymbolId );
+
+    /// ConcurrentInterning - Made before starting threads which intern or
+    /// look up names and destroyed after joining them. Only then do intern
+    /// and symbolName lock the table, one thread goes without.
+    class ConcurrentInterning
+    {
+        public:
+            ConcurrentInterning ( void );
+            ~ConcurrentInterning ( void );
+            ConcurrentInterning ( const ConcurrentInterning & ) = delete;
+            ConcurrentInterning & operator = ( const ConcurrentInterning & ) = delete;
+    };
+}
+
+#endif
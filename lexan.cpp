@@ -2,13 +2,29 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <cctype>
-#include <sstream>
 #include <utility>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if !defined ( MILA_NO_SIMD ) && defined ( __AVX2__ )
+#include <immintrin.h>
+#define MILA_SIMD
+#elif !defined ( MILA_NO_SIMD ) && defined ( __SSE2__ )
+#include <emmintrin.h>
+#define MILA_SIMD
+#endif
 
 using namespace mila;
 
-std::set < std::string > mila::keywords =
+constexpr const char * mila::tokenNames [ TOKEN_KIND_CNT ] =
 {
     "program", "var", "const", "function", "procedure",
     "begin", "end", "forward",
@@ -18,286 +34,897 @@ std::set < std::string > mila::keywords =
     "dec", "inc",
     "div", "mod",
     "not", "and", "or",
-    "array", "of", "integer"
+    "array", "of", "integer",
+    "+", "-", "*", "/", "%",
+    "=", "<", ">", "<=", ">=", "<>",
+    ":=", ":", ".", "..",
+    "(", ")", "[", "]", ",", ";", "'",
+    "", "", "", "", ""
 };
 
+namespace
+{
+    // Perfect hash over the keywords: every keyword is at least two characters
+    // long and (2 * first + second + 15 * length) mod 64 is unique among them.
+    constexpr unsigned keywordHash ( const char * word, std::size_t length )
+    {
+        return ( 2u * static_cast < unsigned char > ( word [ 0 ] )
+               + static_cast < unsigned char > ( word [ 1 ] ) + 15u * length ) & 63u;
+    }
+
+    constexpr std::size_t keywordLength ( const char * word )
+    {
+        return *word ? 1 + keywordLength ( word + 1 ) : 0;
+    }
+
+    // Keyword stored in every hash slot, -1 for empty slots.
+    constexpr signed char keywordSlots [ 64 ] =
+    {
+         2, -1, -1, -1, -1, 16, -1, -1, -1, 19, -1, -1,  9, -1, -1, -1,
+        -1, 15, -1, -1, -1, 13,  8, -1, -1,  4, 21, -1, -1, 26, 23, -1,
+        -1, 11, 29, 18,  7,  6, -1, -1, 12, 30, -1, 17, -1, 22, 27, -1,
+        -1, -1, 10, -1,  5, 14, 24, -1, 25,  3,  1,  0, -1, -1, 20, 28
+    };
+
+    constexpr bool keywordSlotsValid ( int kw = 0 )
+    {
+        return kw == KEYWORD_CNT
+            || ( keywordSlots [ keywordHash ( tokenNames [ kw ], keywordLength ( tokenNames [ kw ] ) ) ] == kw
+                 && keywordSlotsValid ( kw + 1 ) );
+    }
+
+    static_assert ( keywordSlotsValid (), "Keyword hash table does not match tokenNames." );
+}
+
+namespace
+{
+    // Character class scanning. With SSE2 or AVX2 available every class test
+    // runs on a whole block of 16 or 32 bytes; the scalar tests handle the
+    // tail of the buffer and builds with MILA_NO_SIMD.
+#if defined ( MILA_SIMD ) && defined ( __AVX2__ )
+    typedef __m256i Block;
+    const std::size_t BLOCK_SIZE = 32;
+    const unsigned FULL_MASK = 0xffffffffu;
+    inline Block load ( const char * p ) { return _mm256_loadu_si256 ( reinterpret_cast < const Block * > ( p ) ); }
+    inline Block splat ( char c ) { return _mm256_set1_epi8 ( c ); }
+    inline Block eq ( Block a, Block b ) { return _mm256_cmpeq_epi8 ( a, b ); }
+    inline Block gt ( Block a, Block b ) { return _mm256_cmpgt_epi8 ( a, b ); }
+    inline Block both ( Block a, Block b ) { return _mm256_and_si256 ( a, b ); }
+    inline Block either ( Block a, Block b ) { return _mm256_or_si256 ( a, b ); }
+    inline unsigned bits ( Block a ) { return _mm256_movemask_epi8 ( a ); }
+#elif defined ( MILA_SIMD )
+    typedef __m128i Block;
+    const std::size_t BLOCK_SIZE = 16;
+    const unsigned FULL_MASK = 0xffffu;
+    inline Block load ( const char * p ) { return _mm_loadu_si128 ( reinterpret_cast < const Block * > ( p ) ); }
+    inline Block splat ( char c ) { return _mm_set1_epi8 ( c ); }
+    inline Block eq ( Block a, Block b ) { return _mm_cmpeq_epi8 ( a, b ); }
+    inline Block gt ( Block a, Block b ) { return _mm_cmpgt_epi8 ( a, b ); }
+    inline Block both ( Block a, Block b ) { return _mm_and_si128 ( a, b ); }
+    inline Block either ( Block a, Block b ) { return _mm_or_si128 ( a, b ); }
+    inline unsigned bits ( Block a ) { return _mm_movemask_epi8 ( a ); }
+#endif
+
+#ifdef MILA_SIMD
+    // Bytes in [lo, hi]; bytes above 0x7f compare as negative and never match.
+    inline Block inRange ( Block x, char lo, char hi )
+    {
+        return both ( gt ( x, splat ( lo - 1 ) ), gt ( splat ( hi + 1 ), x ) );
+    }
+#endif
+
+    inline bool inRange ( unsigned char c, char lo, char hi )
+    {
+        return c >= static_cast < unsigned char > ( lo ) && c <= static_cast < unsigned char > ( hi );
+    }
+
+    struct Space
+    {
+        static bool test ( unsigned char c ) { return c == ' ' || inRange ( c, '\t', '\r' ); }
+#ifdef MILA_SIMD
+        static Block test ( Block x ) { return either ( eq ( x, splat ( ' ' ) ), inRange ( x, '\t', '\r' ) ); }
+#endif
+    };
+
+    /// span - First character in [p, end) which is not in the class.
+    template < typename Class >
+    const char * span ( const char * p, const char * end )
+    {
+#ifdef MILA_SIMD
+        while ( static_cast < std::size_t > ( end - p ) >= BLOCK_SIZE )
+        {
+            unsigned miss = ~bits ( Class::test ( load ( p ) ) ) & FULL_MASK;
+            if ( miss )
+                return p + __builtin_ctz ( miss );
+            p += BLOCK_SIZE;
+        }
+#endif
+        while ( p != end && Class::test ( static_cast < unsigned char > ( *p ) ) )
+            ++p;
+        return p;
+    }
+
+    /// find - First occurrence of the terminator a (followed by b unless b is
+    /// '\0') in [p, end), or end.
+    const char * find ( const char * p, const char * end, char a, char b = '\0' )
+    {
+        std::size_t extra = b ? 1 : 0;
+#ifdef MILA_SIMD
+        while ( static_cast < std::size_t > ( end - p ) >= BLOCK_SIZE + extra )
+        {
+            Block hit = eq ( load ( p ), splat ( a ) );
+            if ( b )
+                hit = both ( hit, eq ( load ( p + 1 ), splat ( b ) ) );
+            if ( unsigned m = bits ( hit ) )
+                return p + __builtin_ctz ( m );
+            p += BLOCK_SIZE;
+        }
+#endif
+        for ( ; static_cast < std::size_t > ( end - p ) > extra ; ++p )
+            if ( *p == a && ( !b || p [ 1 ] == b ) )
+                return p;
+        return end;
+    }
+}
+
+namespace
+{
+    // Table driven scanner. The rules are written over character classes and
+    // expanded at compile time into one table indexed by state and byte, with
+    // an extra column END_COLUMN for the end of input. States from FIRST_FINAL
+    // on end the symbol; CONSUME marks steps which take the byte into the
+    // symbol, all other steps leave it for the next one.
+    enum CharClass : unsigned char
+    {
+        CC_SPACE,
+        CC_ZERO,            // 0
+        CC_OCTAL,           // 1-7
+        CC_DECIMAL,         // 8 9
+        CC_HEX_LETTER,      // a-f A-F
+        CC_X,               // x X
+        CC_LETTER,
+        CC_UNDERSCORE,
+        CC_DOT,
+        CC_LESS,
+        CC_GREATER,
+        CC_COLON,
+        CC_EQUAL,
+        CC_DOLLAR,
+        CC_AMPERSAND,
+        CC_SINGLE,          // operators which never take a second character
+        CC_OTHER,
+        CC_END,             // not a byte, the end of input
+        CLASS_CNT
+    };
+
+    enum ScanState : unsigned char
+    {
+        S_START,
+        S_WORD,
+        S_ZERO,
+        S_ZERO_X,
+        S_OCTAL,
+        S_DECIMAL,
+        S_HEXADECIMAL,
+        S_DOT,
+        S_LESS,
+        S_GREATER,
+        S_COLON,
+        S_DOLLAR,
+        S_AMPERSAND,
+        FIRST_FINAL,
+        F_IDENTIFIER = FIRST_FINAL,
+        F_OCTAL,
+        F_DECIMAL,
+        F_HEXADECIMAL,
+        F_SINGLE,
+        F_DOT,
+        F_DOT_DOT,
+        F_LESS,
+        F_LESS_EQUAL,
+        F_NOT_EQUAL,
+        F_GREATER,
+        F_GREATER_EQUAL,
+        F_COLON,
+        F_ASSIGN,
+        F_END,
+        F_BAD_OCTAL,
+        F_BAD_DECIMAL,
+        F_BAD_HEXADECIMAL,
+        F_BAD_LEADING_ZERO,
+        F_BAD_ZERO_X,
+        F_BAD_OPERATOR,
+        F_WHITE_SPACE,
+        STATE_CNT
+    };
+
+    const unsigned char CONSUME = 0x80;
+    const unsigned END_COLUMN = 256;
+
+    constexpr CharClass classify ( unsigned char c )
+    {
+        return c == ' ' || ( c >= '\t' && c <= '\r' ) ? CC_SPACE
+             : c == '0' ? CC_ZERO
+             : c >= '1' && c <= '7' ? CC_OCTAL
+             : c == '8' || c == '9' ? CC_DECIMAL
+             : ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'f' ? CC_HEX_LETTER
+             : ( c | 0x20 ) == 'x' ? CC_X
+             : ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'z' ? CC_LETTER
+             : c == '_' ? CC_UNDERSCORE
+             : c == '.' ? CC_DOT
+             : c == '<' ? CC_LESS
+             : c == '>' ? CC_GREATER
+             : c == ':' ? CC_COLON
+             : c == '=' ? CC_EQUAL
+             : c == '$' ? CC_DOLLAR
+             : c == '&' ? CC_AMPERSAND
+             : c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '(' || c == ')'
+               || c == '[' || c == ']' || c == ',' || c == ';' || c == '\'' ? CC_SINGLE
+             : CC_OTHER;
+    }
+
+    constexpr bool isDigit ( CharClass c )
+    {
+        return c == CC_ZERO || c == CC_OCTAL || c == CC_DECIMAL;
+    }
+
+    constexpr bool isLetter ( CharClass c )
+    {
+        return c == CC_HEX_LETTER || c == CC_X || c == CC_LETTER;
+    }
+
+    /// transition - The scanner rules. Numbers run over all letters and
+    /// digits and fail on the first one which is not a digit of their base.
+    constexpr unsigned char transition ( ScanState s, CharClass c )
+    {
+        switch ( s )
+        {
+            case S_START:
+                switch ( c )
+                {
+                    case CC_SPACE:          return F_WHITE_SPACE | CONSUME;
+                    case CC_ZERO:           return S_ZERO | CONSUME;
+                    case CC_OCTAL:
+                    case CC_DECIMAL:        return S_DECIMAL | CONSUME;
+                    case CC_HEX_LETTER:
+                    case CC_X:
+                    case CC_LETTER:         return S_WORD | CONSUME;
+                    case CC_DOT:            return S_DOT | CONSUME;
+                    case CC_LESS:           return S_LESS | CONSUME;
+                    case CC_GREATER:        return S_GREATER | CONSUME;
+                    case CC_COLON:          return S_COLON | CONSUME;
+                    case CC_DOLLAR:         return S_DOLLAR | CONSUME;
+                    case CC_AMPERSAND:      return S_AMPERSAND | CONSUME;
+                    case CC_EQUAL:
+                    case CC_SINGLE:         return F_SINGLE | CONSUME;
+                    case CC_END:            return F_END;
+                    default:                return F_BAD_OPERATOR | CONSUME;
+                }
+            case S_WORD:
+                return isDigit ( c ) || isLetter ( c ) || c == CC_UNDERSCORE ? S_WORD | CONSUME : F_IDENTIFIER;
+            case S_ZERO:
+                return c == CC_X ? S_ZERO_X | CONSUME
+                     : isLetter ( c ) ? F_BAD_LEADING_ZERO | CONSUME
+                     : transition ( S_OCTAL, c );
+            case S_ZERO_X:
+                return isDigit ( c ) || isLetter ( c ) ? transition ( S_HEXADECIMAL, c ) : F_BAD_ZERO_X;
+            case S_OCTAL:
+                return c == CC_ZERO || c == CC_OCTAL ? S_OCTAL | CONSUME
+                     : isDigit ( c ) || isLetter ( c ) ? F_BAD_OCTAL : F_OCTAL;
+            case S_DECIMAL:
+                return isDigit ( c ) ? S_DECIMAL | CONSUME
+                     : isLetter ( c ) ? F_BAD_DECIMAL : F_DECIMAL;
+            case S_HEXADECIMAL:
+                return isDigit ( c ) || c == CC_HEX_LETTER ? S_HEXADECIMAL | CONSUME
+                     : isLetter ( c ) ? F_BAD_HEXADECIMAL : F_HEXADECIMAL;
+            case S_DOT:
+                return c == CC_DOT ? F_DOT_DOT | CONSUME : F_DOT;
+            case S_LESS:
+                return c == CC_GREATER ? F_NOT_EQUAL | CONSUME
+                     : c == CC_EQUAL ? F_LESS_EQUAL | CONSUME : F_LESS;
+            case S_GREATER:
+                return c == CC_EQUAL ? F_GREATER_EQUAL | CONSUME : F_GREATER;
+            case S_COLON:
+                return c == CC_EQUAL ? F_ASSIGN | CONSUME : F_COLON;
+            case S_DOLLAR:
+                return isDigit ( c ) || c == CC_HEX_LETTER ? S_HEXADECIMAL | CONSUME : F_BAD_OPERATOR;
+            case S_AMPERSAND:
+                return isDigit ( c ) ? transition ( S_OCTAL, c ) : F_BAD_OPERATOR;
+            default:
+                return s;
+        }
+    }
+
+    struct ScanTables
+    {
+        unsigned char next [ FIRST_FINAL ] [ END_COLUMN + 1 ];
+        TokenKind kinds [ 256 ];
+        TokenKind operators [ STATE_CNT ];
+
+        constexpr ScanTables ( void )
+        : next (), kinds (), operators ()
+        {
+            for ( int s = 0 ; s < FIRST_FINAL ; s ++ )
+            {
+                for ( int c = 0 ; c < 256 ; c ++ )
+                    next [ s ] [ c ] = transition ( ScanState ( s ), classify ( c ) );
+                next [ s ] [ END_COLUMN ] = transition ( ScanState ( s ), CC_END );
+            }
+            for ( int c = 0 ; c < 256 ; c ++ )
+                kinds [ c ] = TK_ERROR;
+            for ( int kind = OP_PLUS ; kind < TK_IDENTIFIER ; kind ++ )
+                if ( !tokenNames [ kind ] [ 1 ] )
+                    kinds [ static_cast < unsigned char > ( tokenNames [ kind ] [ 0 ] ) ] = TokenKind ( kind );
+            operators [ F_DOT ] = OP_DOT;
+            operators [ F_DOT_DOT ] = OP_DOT_DOT;
+            operators [ F_LESS ] = OP_LESS;
+            operators [ F_LESS_EQUAL ] = OP_LESS_EQUAL;
+            operators [ F_NOT_EQUAL ] = OP_NOT_EQUAL;
+            operators [ F_GREATER ] = OP_GREATER;
+            operators [ F_GREATER_EQUAL ] = OP_GREATER_EQUAL;
+            operators [ F_COLON ] = OP_COLON;
+            operators [ F_ASSIGN ] = OP_ASSIGN;
+        }
+
+        /// valid - Every state ends the symbol at the end of input without
+        /// taking anything, so the scan loop never reads past the buffer.
+        constexpr bool valid ( void ) const
+        {
+            for ( int s = 0 ; s < FIRST_FINAL ; s ++ )
+                if ( next [ s ] [ END_COLUMN ] < FIRST_FINAL || ( next [ s ] [ END_COLUMN ] & CONSUME ) )
+                    return false;
+            return true;
+        }
+    };
+
+    constexpr ScanTables scanTables;
+    static_assert ( scanTables . valid (), "Scanner must stop at the end of input." );
+
+    int digitValue ( char c )
+    {
+        return c <= '9' ? c - '0' : ( c | 0x20 ) - 'a' + 10;
+    }
+}
+
+SymbolId mila::kindSymbol ( TokenKind kind )
+{
+    static const std::vector < SymbolId > ids = []
+    {
+        std::vector < SymbolId > ids;
+        for ( const char * name : tokenNames )
+            ids . push_back ( intern ( name ) );
+        return ids;
+    } ();
+    return ids [ kind ];
+}
+
+TokenKind mila::findKeyword ( const char * word, std::size_t length )
+{
+    if ( length < 2 )
+        return TK_IDENTIFIER;
+    int kw = keywordSlots [ keywordHash ( word, length ) ];
+    if ( kw < 0 || strncmp ( tokenNames [ kw ], word, length ) || tokenNames [ kw ] [ length ] )
+        return TK_IDENTIFIER;
+    return TokenKind ( kw );
+}
+
+mila::SourceBuffer::SourceBuffer ( std::istream & is )
+: data ( nullptr ), length ( 0 ), mapping ( nullptr ), failed ( false )
+{
+    if ( !is . good () )
+    {
+        failed = true;
+        return;
+    }
+    char chunk [ 1 << 16 ];
+    while ( is . read ( chunk, sizeof ( chunk ) ) || is . gcount () )
+        storage . insert ( storage . end (), chunk, chunk + is . gcount () );
+    data = storage . data ();
+    length = storage . size ();
+}
+
+mila::SourceBuffer::SourceBuffer ( const char * fileName )
+: data ( nullptr ), length ( 0 ), mapping ( nullptr ), failed ( false )
+{
+    int fd = open ( fileName, O_RDONLY );
+    struct stat st;
+    if ( fd < 0 || fstat ( fd, &st ) < 0 )
+    {
+        if ( fd >= 0 )
+            close ( fd );
+        failed = true;
+        return;
+    }
+    if ( S_ISREG ( st . st_mode ) && st . st_size > 0 )
+    {
+        void * addr = mmap ( nullptr, st . st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( addr != MAP_FAILED )
+        {
+            madvise ( addr, st . st_size, MADV_SEQUENTIAL );
+            mapping = addr;
+            data = static_cast < const char * > ( addr );
+            length = st . st_size;
+            close ( fd );
+            return;
+        }
+    }
+    // Pipes, character devices and unmappable files are read in whole.
+    char chunk [ 1 << 16 ];
+    ssize_t got;
+    while ( ( got = read ( fd, chunk, sizeof ( chunk ) ) ) > 0 )
+        storage . insert ( storage . end (), chunk, chunk + got );
+    if ( got < 0 )
+        failed = true;
+    close ( fd );
+    data = storage . data ();
+    length = storage . size ();
+}
+
+mila::SourceBuffer::SourceBuffer ( SourceBuffer && other )
+: storage ( std::move ( other . storage ) ), data ( other . data ), length ( other . length ),
+mapping ( other . mapping ), failed ( other . failed )
+{
+    other . data = nullptr;
+    other . length = 0;
+    other . mapping = nullptr;
+}
+
+mila::SourceBuffer::~SourceBuffer ( void )
+{
+    if ( mapping )
+        munmap ( mapping, length );
+}
+
+const char * mila::SourceBuffer::begin ( void ) const
+{
+    return data;
+}
+
+const char * mila::SourceBuffer::end ( void ) const
+{
+    return data + length;
+}
+
+std::size_t mila::SourceBuffer::size ( void ) const
+{
+    return length;
+}
+
+bool mila::SourceBuffer::good ( void ) const
+{
+    return !failed;
+}
+
+mila::SourceBuffer::SourceBuffer ( const char * from, const char * to, bool failed )
+: data ( from ), length ( to - from ), mapping ( nullptr ), failed ( failed )
+{
+}
+
+SourceBuffer mila::SourceBuffer::slice ( const char * from ) const
+{
+    return SourceBuffer ( from, end (), failed );
+}
+//==========================================================================
 mila::Lexan::Lexan ( std::istream && is )
-: input ( move ( is ) )
+: Lexan ( SourceBuffer ( is ) )
+{
+}
+
+mila::Lexan::Lexan ( SourceBuffer && buffer )
+: source ( std::move ( buffer ) ), cur ( source . begin () ), last ( source . end () ), atEnd ( false ),
+head ( 0 ), buffered ( 0 )
 {
 }
 //==========================================================================
 Lexan & mila::Lexan::operator << ( const LexicalSymbol & ls )
 {
-    que . push ( ls );
+    assert ( buffered < LOOKAHEAD );
+    head = ( head + LOOKAHEAD - 1 ) % LOOKAHEAD;
+    ring [ head ] = ls;
+    buffered ++;
     return *this;
 }
 
 Lexan & mila::Lexan::operator >> ( LexicalSymbol & ls )
 {
-    if ( !que . empty () )
+    if ( buffered )
+    {
+        ls = ring [ head ];
+        skip ();
+    }
+    else
+        scan ( ls );
+    return *this;
+}
+
+const LexicalSymbol & mila::Lexan::peek ( std::size_t n )
+{
+    assert ( n < LOOKAHEAD );
+    for ( ; buffered <= n ; buffered ++ )
+        scan ( ring [ ( head + buffered ) % LOOKAHEAD ] );
+    return ring [ ( head + n ) % LOOKAHEAD ];
+}
+
+void mila::Lexan::skip ( void )
+{
+    if ( !buffered )
+        peek ();
+    head = ( head + 1 ) % LOOKAHEAD;
+    buffered --;
+}
+
+void mila::Lexan::scan ( LexicalSymbol & ls )
+{
+    ls . name = 0;
+    if ( !clearSpace () )
+    {
+        ls . type = ERROR;
+        ls . kind = TK_ERROR;
+        ls . name = intern ( "Unterminated comment." );
+        return;
+    }
+    if ( cur != last && *cur == '{' )
     {
-        ls = que . front ();
-        que . pop ();
-        return *this;
+        directive ( ls );
+        return;
     }
-    clearSpace ();
-    InputCharacter next;
-    getNext ( next );
-    goto S;
-S:
-    switch ( next . type )
+    const char * start = cur;
+    unsigned state = S_START;
+    do
     {
-        case NUMBER:
+        // Runs of bytes which keep the state, like the tail of a word or
+        // a number, do not depend on the previous step and go faster.
+        const unsigned char * row = scanTables . next [ state ];
+        unsigned step = 0;
+        while ( cur != last && ( step = row [ static_cast < unsigned char > ( *cur ) ] ) == ( state | CONSUME ) )
+            ++cur;
+        if ( cur == last )
+        {
+            atEnd = true;
+            step = row [ END_COLUMN ];
+        }
+        cur += step >> 7;
+        state = step & ~CONSUME;
+    }
+    while ( state < FIRST_FINAL );
+
+    int base = 8;
+    const char * digits = start;
+    std::string message;
+    switch ( state )
+    {
+        case F_IDENTIFIER:
+            ls . type = IDENTIFIER;
+            checkKeyword ( ls, start, cur - start );
+            return;
+        case F_HEXADECIMAL:
+            base += 8;
+            digits += *start == '$' ? 1 : 2;
+            goto number;
+        case F_DECIMAL:
+            base += 2;
+            goto number;
+        case F_OCTAL:
+            digits += *start == '&';
+        number:
             ls . type = INTEGER;
+            ls . kind = TK_INTEGER;
             ls . value = 0;
-            if ( next . value == '0' )
-                goto octa;
-            else
-                goto deca;
-        case LETTER:
-            ls . name . clear ();
-            goto word;
-        case OTHER:
-            ls . name . clear ();
-            goto other;
-        case WHITE_SPACE:
-            ls . type = ERROR;
-            ls . name = "Uncaught white space.";
-            return *this;
-        case EOI:
-            ls . type = END_OF_INPUT;
-            return *this;
-        case FAIL:
-            ls . type = ERROR;
-            ls . name = "Error reading from stream.";
-            return *this;
-    }
-octa:
-    getNext ( next );
-    switch ( next . type )
-    {
-        case LETTER:
-            if ( next . value == 'x' || next . value == 'X' )
-                goto hexa;
-            ls . type = ERROR;
-            ls . name = "Identifier cannot start with a number.";
-            return *this;
-        case NUMBER:
-            input . unget ();
-            readNumber ( ls, 8 );
-            return *this;
-        default:
-            input . unget ();
-        case EOI:
-            ls . value = 0;
-            return *this;
-    }
-deca:
-    input . unget ();
-    readNumber ( ls, 10 );
-    return *this;
-hexa:
-    getNext ( next );
-    switch ( next . type )
-    {
-        case NUMBER:
-        case LETTER:
-            input . unget ();
-            readNumber ( ls, 16 );
-            return *this;
-        default:
-            input . unget ();
-        case EOI:
-            ls . type = ERROR;
-            ls . name = "Symbol \"0x\" is invalid.";
-            return *this;
-    }
-word:
-    ls . type = IDENTIFIER;
-    ls . name += next . value;
-    getNext ( next );
-    switch ( next . type )
-    {
-        case NUMBER:
-        case LETTER:
-            goto word;
-        case OTHER:
-            if ( next . value == '_' )
-                goto word;
-        default:
-            input . unget ();
-        case EOI:
-            checkKeyword ( ls );
-            return *this;
-    }
-other:
-    ls . type = OPERATOR;
-    ls . name += next . value;
-    switch ( next . value )
-    {
-        case '.':
-            if ( input . peek () == '.' )
-            {
-                input . get ();
-                ls . name += '.';
-                return *this;
-            }
-            return *this;
-        case '<':
-            if ( input . peek () == '>' )
-            {
-                input . get ();
-                ls . name += '>';
-                return *this;
-            }
-        case ':':
-        case '>':
-            if ( input . peek () == '=' )
-            {
-                input . get ();
-                ls . name += '=';
-            }
-        case '+':
-        case '-':
-        case '*':
-        case '/':
-        case '%':
-        case '=':
-        case '(':
-        case ')':
-        case '[':
-        case ']':
-        case ',':
-        case ';':
-        case '\'':
-            return *this;
-        case '$':
-            if ( isxdigit ( input . peek () ) )
-            {
-                ls . type = INTEGER;
-                ls . value = 0;
-                goto hexa;
-            }
-        case '&':
-            if ( isdigit ( input . peek () ) )
+            for ( ; digits != cur ; ++digits )
+                ls . value = ls . value * base + digitValue ( *digits );
+            return;
+        case F_SINGLE:
+            ls . type = OPERATOR;
+            ls . kind = scanTables . kinds [ static_cast < unsigned char > ( *start ) ];
+            ls . name = kindSymbol ( ls . kind );
+            return;
+        case F_END:
+            if ( source . good () )
             {
-                ls . type = INTEGER;
-                ls . value = 0;
-                goto octa;
+                ls . type = END_OF_INPUT;
+                ls . kind = TK_END_OF_INPUT;
+                return;
             }
+            message = "Error reading from stream.";
+            break;
+        case F_BAD_HEXADECIMAL:
+            base += 6;
+        case F_BAD_DECIMAL:
+            base += 2;
+        case F_BAD_OCTAL:
+            message = "Number in base " + std::to_string ( base ) + " cannot contain character '" + *cur + "'.";
+            break;
+        case F_BAD_LEADING_ZERO:
+            message = "Identifier cannot start with a number.";
+            break;
+        case F_BAD_ZERO_X:
+            message = "Symbol \"0x\" is invalid.";
+            break;
+        case F_BAD_OPERATOR:
+            message = "Unrecognized operator '" + std::string ( start, cur ) + "'.";
+            break;
+        case F_WHITE_SPACE:
+            message = "Uncaught white space.";
+            break;
         default:
-            ls . type = ERROR;
-            std::stringstream ss;
-            ss << "Unrecognized operator '" << ls . name << "'.";
-            ls . name = ss . str ();
-            return *this;
+            ls . type = OPERATOR;
+            ls . kind = scanTables . operators [ state ];
+            ls . name = kindSymbol ( ls . kind );
+            return;
     }
-    return *this;
+    ls . type = ERROR;
+    ls . kind = TK_ERROR;
+    ls . name = intern ( message );
 }
 //==========================================================================
 bool mila::Lexan::eof ( void ) const
 {
-    return input . eof ();
+    return !buffered && atEnd && source . good ();
 }
 
-void mila::Lexan::clearSpace ( void )
+std::size_t mila::Lexan::size ( void ) const
 {
-    while ( isspace ( input . peek () ) )
-        input . get ();
+    return source . size ();
 }
 
-void mila::Lexan::getNext ( InputCharacter & ic )
+const char * mila::Lexan::position ( void ) const
 {
-    if ( !input . get ( ic . value ) )
-    {
-        if ( input . eof () )
-            ic . type = EOI;
-        else
-            ic . type = FAIL;
-    }
-    else if ( isalpha ( ic . value ) )
-        ic . type = LETTER;
-    else if ( isdigit ( ic . value ) )
-        ic . type = NUMBER;
-    else if ( isspace ( ic . value ) )
-        ic . type = WHITE_SPACE;
-    else
-        ic . type = OTHER;
+    return cur;
 }
 
-void mila::Lexan::readNumber ( LexicalSymbol & ls, int base )
+const SourceBuffer & mila::Lexan::input ( void ) const
+{
+    return source;
+}
+//==========================================================================
+namespace
 {
-    ls . value = 0;
-    char next;
-    while ( isalnum (( next = input . peek () )) )
+    /// Chunk - Symbols lexed speculatively from a split point up to limit,
+    /// or to the end of input if limit is null. starts holds
+    /// the position every symbol was scanned from; stop is where lexing
+    /// would continue, unless finished says the symbol stream ended here.
+    struct Chunk
     {
-        int nextVal;
-        if ( !checkDigit ( next, base, nextVal ) )
+        const char * from;
+        const char * limit;
+        std::vector < const char * > starts;
+        std::vector < LexicalSymbol > symbols;
+        const char * stop;
+        bool finished;
+    };
+
+    /// lexUntil - Lex from lex into out until a symbol would start at or past
+    /// a non-null limit, the input ends, an error is read or sync returns true for the
+    /// current position. Returns whether the stream ended.
+    template < typename Sync >
+    bool lexUntil ( Lexan & lex, const char * limit, std::vector < const char * > * starts,
+                    std::vector < LexicalSymbol > & out, Sync sync )
+    {
+        LexicalSymbol ls;
+        while ( !lex . eof () )
         {
-            ls . type = ERROR;
-            std::stringstream ss;
-            ss << "Number in base " << base << " cannot contain character '" << next << "'.";
-            ls . name = ss . str ();
-            return;
+            const char * at = lex . position ();
+            if ( ( limit && at >= limit ) || sync ( at ) )
+                return false;
+            lex >> ls;
+            if ( starts )
+                starts -> push_back ( at );
+            out . push_back ( ls );
+            if ( ls . type == ERROR )
+                return true;
         }
-        ls . value = ls . value * base + nextVal;
-        if ( !input . get () )
-            return;
+        return true;
+    }
+
+    void lexChunk ( const SourceBuffer & source, Chunk & chunk, bool alone )
+    {
+        // Roughly one symbol per four bytes in typical sources.
+        std::size_t estimate = ( ( chunk . limit ? chunk . limit : source . end () ) - chunk . from ) / 4 + 1;
+        chunk . symbols . reserve ( estimate );
+        if ( !alone )
+            chunk . starts . reserve ( estimate );
+        Lexan lex ( source . slice ( chunk . from ) );
+        chunk . finished = lexUntil ( lex, chunk . limit, alone ? nullptr : &chunk . starts, chunk . symbols,
+                                      [] ( const char * ) { return false; } );
+        chunk . stop = lex . position ();
     }
 }
 
-int mila::Lexan::checkDigit ( char num, int base, int & val )
+std::vector < LexicalSymbol > mila::lexParallel ( const SourceBuffer & source, unsigned threads, std::size_t minChunk )
 {
-    if ( isdigit ( num ) )
-        val = num - '0';
-    else if ( islower ( num ) )
-        val = num - 'a' + 10;
-    else if ( isupper ( num ) )
-        val = num - 'A' + 10;
-    else
-        return 0;
-    if ( val >= base )
-        return 0;
-    return 1;
+    // Split points are moved forward to whitespace or ';' so that no two
+    // character operator ('..', ':=', '<>', '<=', '>=') and no number with
+    // its '$' or '&' prefix is cut in half. A split can still land inside
+    // a comment; such a chunk lexes garbage until it happens to resync.
+    std::size_t count = std::max ( 1u, threads ) * 4;
+    count = std::max < std::size_t > ( 1, std::min ( count, source . size () / std::max < std::size_t > ( minChunk, 1 ) ) );
+    if ( !source . good () || threads <= 1 )
+        count = 1;
+
+    std::vector < Chunk > chunks ( count );
+    const char * end = source . end ();
+    const char * prev = source . begin ();
+    for ( std::size_t i = 0 ; i < count ; i ++ )
+    {
+        const char * p = source . begin () + source . size () / count * i;
+        p = std::max ( p, prev );
+        while ( p < end && !Space::test ( *p ) && *p != ';' )
+            p ++;
+        chunks [ i ] . from = i ? p : source . begin ();
+        if ( i )
+            chunks [ i - 1 ] . limit = chunks [ i ] . from;
+        prev = chunks [ i ] . from;
+    }
+    chunks . back () . limit = nullptr;
+
+    std::atomic < std::size_t > next ( 0 );
+    auto worker = [&] ()
+    {
+        for ( std::size_t i ; ( i = next ++ ) < count ; )
+            lexChunk ( source, chunks [ i ], count == 1 );
+    };
+    {
+        ConcurrentInterning concurrently;
+        std::vector < std::thread > pool;
+        for ( unsigned t = 1 ; t < threads && t < count ; t ++ )
+            pool . emplace_back ( worker );
+        worker ();
+        for ( std::thread & t : pool )
+            t . join ();
+    }
+
+    // Lexing depends on nothing but the position, so once the true stream
+    // reaches a position some chunk also started a symbol from, the rest of
+    // that chunk is exactly what sequential lexing would give.
+    if ( count == 1 )
+        return std::move ( chunks [ 0 ] . symbols );
+    std::vector < LexicalSymbol > symbols;
+    std::size_t total = 0;
+    for ( const Chunk & chunk : chunks )
+        total += chunk . symbols . size ();
+    symbols . reserve ( total );
+    const char * at = source . begin ();
+    std::size_t i = 0;
+    while ( i < count )
+    {
+        Chunk & chunk = chunks [ i ];
+        auto hit = std::lower_bound ( chunk . starts . begin (), chunk . starts . end (), at );
+        if ( hit != chunk . starts . end () && *hit == at )
+        {
+            symbols . insert ( symbols . end (), chunk . symbols . begin () + ( hit - chunk . starts . begin () ),
+                               chunk . symbols . end () );
+            if ( chunk . finished )
+                break;
+            at = chunk . stop;
+            i ++;
+            continue;
+        }
+        // No resync yet: lex the chunk again from the true position.
+        Lexan lex ( source . slice ( at ) );
+        if ( lexUntil ( lex, chunk . limit, nullptr, symbols,
+                        [&chunk] ( const char * p ) { return std::binary_search ( chunk . starts . begin (), chunk . starts . end (), p ); } ) )
+            break;
+        at = lex . position ();
+        if ( chunk . limit && at >= chunk . limit )
+            i ++;
+    }
+    return symbols;
 }
 
-void mila::Lexan::checkKeyword ( LexicalSymbol & ls )
+bool mila::Lexan::clearSpace ( void )
 {
-    if ( keywords . count ( ls . name ) )
+    while ( true )
     {
-        ls . type = KEYWORD;
-        return;
+        cur = span < Space > ( cur, last );
+        if ( cur == last )
+        {
+            atEnd = true;
+            return true;
+        }
+        const char * close;
+        std::size_t closing;
+        // a comment starting with '$' is a directive, it is scanned
+        if ( *cur == '{' && !( last - cur > 1 && cur [ 1 ] == '$' ) )
+        {
+            close = find ( cur + 1, last, '}' );
+            closing = 1;
+        }
+        else if ( *cur == '(' && last - cur > 1 && cur [ 1 ] == '*' )
+        {
+            close = find ( cur + 2, last, '*', ')' );
+            closing = 2;
+        }
+        else
+            return true;
+        // an unterminated comment runs to the end of the input
+        if ( close == last )
+        {
+            cur = last;
+            atEnd = true;
+            return false;
+        }
+        cur = close + closing;
     }
 }
 
-mila::LexicalSymbol::LexicalSymbol ( void )
-: type ( ERROR ), name ( "Uninitialized lexical symbol." )
+/// directive - Scan the directive at cur, a name and an optional decimal
+/// number between "{$" and "}".
+void mila::Lexan::directive ( LexicalSymbol & ls )
 {
+    const char * close = find ( cur + 2, last, '}' );
+    const char * name = span < Space > ( cur + 2, close ), * p = name;
+    while ( p != close && ( inRange ( *p, 'a', 'z' ) || inRange ( *p, 'A', 'Z' ) ) )
+        ++p;
+    std::size_t length = p - name;
+    p = span < Space > ( p, close );
+    ls . value = -1;
+    if ( p != close && inRange ( *p, '0', '9' ) )
+    {
+        for ( ls . value = 0 ; p != close && inRange ( *p, '0', '9' ) ; ++p )
+            ls . value = ls . value * 10 + ( *p - '0' );
+        p = span < Space > ( p, close );
+    }
+    ls . type = ERROR;
+    ls . kind = TK_ERROR;
+    if ( close == last )
+    {
+        cur = last;
+        atEnd = true;
+        ls . name = intern ( "Unterminated comment." );
+        return;
+    }
+    cur = close + 1;
+    if ( !length || p != close )
+    {
+        ls . name = intern ( "Malformed directive." );
+        return;
+    }
+    ls . type = DIRECTIVE;
+    ls . kind = TK_DIRECTIVE;
+    ls . name = intern ( name, length );
 }
 
-mila::LexicalSymbol::LexicalSymbol ( SymbolType st )
-: type ( st ), name ( "" ), value ( -1 )
+void mila::Lexan::checkKeyword ( LexicalSymbol & ls, const char * word, std::size_t length )
 {
+    ls . kind = findKeyword ( word, length );
+    if ( ls . kind != TK_IDENTIFIER )
+    {
+        ls . type = KEYWORD;
+        ls . name = kindSymbol ( ls . kind );
+    }
+    else
+        ls . name = intern ( word, length );
 }
 
-mila::LexicalSymbol::LexicalSymbol ( const char * symbol )
-: LexicalSymbol ( std::string ( symbol ) )
+mila::LexicalSymbol::LexicalSymbol ( void )
+: type ( ERROR ), kind ( TK_ERROR )
 {
+    static const SymbolId uninitialized = intern ( "Uninitialized lexical symbol." );
+    name = uninitialized;
 }
 
-mila::LexicalSymbol::LexicalSymbol ( const std::string & symbol )
+mila::LexicalSymbol::LexicalSymbol ( TokenKind tk )
+: kind ( tk ), name ( kindSymbol ( tk ) ), value ( -1 )
 {
-    std::stringstream input ( symbol );
-    Lexan lex ( move ( input ) );
-    lex >> *this;
-    LexicalSymbol eoi;
-    lex >> eoi;
-    if ( eoi . type != END_OF_INPUT )
+    switch ( tk )
     {
-        this -> type = ERROR;
-        std::stringstream error;
-        error << "Cannot build single symbol from \"" << symbol << "\".";
-        this -> name = error . str ();
+        case TK_IDENTIFIER:
+            type = IDENTIFIER;
+            break;
+        case TK_INTEGER:
+            type = INTEGER;
+            break;
+        case TK_DIRECTIVE:
+            type = DIRECTIVE;
+            break;
+        case TK_END_OF_INPUT:
+            type = END_OF_INPUT;
+            break;
+        case TK_ERROR:
+            type = ERROR;
+            break;
+        default:
+            type = tk < KEYWORD_CNT ? KEYWORD : OPERATOR;
     }
 }
 
@@ -309,8 +936,8 @@ namespace mila
         {
             case IDENTIFIER:
                 os << "IDENTIFIER";
-                if ( !ls . name . empty () )
-                    os << " - " << ls . name;
+                if ( ls . name )
+                    os << " - " << symbolName ( ls . name );
                 return os;
             case INTEGER:
                 os << "INTEGER";
@@ -319,18 +946,25 @@ namespace mila
                 return os;
             case KEYWORD:
                 os << "KEYWORD";
-                if ( !ls . name . empty () )
-                    os << " - " << ls . name;
+                if ( ls . name )
+                    os << " - " << symbolName ( ls . name );
+                return os;
+            case DIRECTIVE:
+                os << "DIRECTIVE";
+                if ( ls . name )
+                    os << " - " << symbolName ( ls . name );
+                if ( ls . value != -1 )
+                    os << " " << ls . value;
                 return os;
             case OPERATOR:
                 os << "OPERATOR";
-                if ( !ls . name . empty () )
-                    os << " - " << ls . name;
+                if ( ls . name )
+                    os << " - " << symbolName ( ls . name );
                 return os;
             case END_OF_INPUT:
                 return os << "END OF INPUT";
             case ERROR:
-                return os << "ERROR - " << ls . name;
+                return os << "ERROR - " << symbolName ( ls . name );
         }
         os << "ERROR - Unrecognized type of lexical symbol.";
         return os;
@@ -339,17 +973,17 @@ namespace mila
 
 bool mila::LexicalSymbol::operator == ( const LexicalSymbol & ls ) const
 {
-    if ( type != ls . type )
+    if ( kind != ls . kind )
         return false;
-    switch ( type )
+    switch ( kind )
     {
-        case IDENTIFIER:
-        case OPERATOR:
-        case KEYWORD:
-        case ERROR:
+        case TK_IDENTIFIER:
+        case TK_ERROR:
             return name == ls . name;
-        case INTEGER:
+        case TK_INTEGER:
             return value == ls . value;
+        case TK_DIRECTIVE:
+            return name == ls . name && value == ls . value;
         default:;
     }
     return true;
@@ -360,31 +994,22 @@ bool mila::LexicalSymbol::operator != ( const LexicalSymbol & ls ) const
     return !( *this == ls );
 }
 
-bool mila::LexicalSymbol::operator == ( const char * symbol ) const
-{
-    return *this == LexicalSymbol ( symbol );
-}
-
-bool mila::LexicalSymbol::operator != ( const char * symbol ) const
-{
-    return !( *this == symbol );
-}
-
 std::size_t std::hash < mila::LexicalSymbol >::operator () ( const mila::LexicalSymbol & ls ) const
 {
-    std::size_t ret = std::hash < int > {} ( ls . type );
-    switch ( ls . type )
+    std::size_t ret = std::hash < int > {} ( ls . kind );
+    switch ( ls . kind )
     {
-        case IDENTIFIER:
-        case OPERATOR:
-        case KEYWORD:
-        case ERROR:
-            ret += std::hash < std::string > {} ( ls . name );
+        case mila::TK_IDENTIFIER:
+        case mila::TK_ERROR:
+            ret += std::hash < SymbolId > {} ( ls . name );
             break;
-        case INTEGER:
+        case mila::TK_INTEGER:
             ret += std::hash < int > {} ( ls . value );
             break;
-        case END_OF_INPUT:
+        case mila::TK_DIRECTIVE:
+            ret += std::hash < SymbolId > {} ( ls . name ) + std::hash < int > {} ( ls . value );
+            break;
+        default:
             break;
     }
     return ret;
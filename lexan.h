@@ -1,36 +1,92 @@
+#include "interner.h"
 #include <iostream>
 #include <string>
-#include <set>
-#include <queue>
+#include <vector>
+#include <cstddef>
 
 #ifndef MILA_LEXAN_H
 #define MILA_LEXAN_H
 
 namespace mila
 {
-    extern std::set < std::string > keywords;
-
-    enum GraphemType
-    {
-        LETTER,
-        NUMBER,
-        WHITE_SPACE,
-        EOI,
-        FAIL,
-        OTHER,
-    };
-    struct InputCharacter
+    /// TokenKind - Closed set of token kinds. Keywords come first, in the order
+    /// of keywordNames, followed by operators and the remaining symbol types.
+    enum TokenKind
     {
-        GraphemType type;
-        char value;
+        KW_PROGRAM,
+        KW_VAR,
+        KW_CONST,
+        KW_FUNCTION,
+        KW_PROCEDURE,
+        KW_BEGIN,
+        KW_END,
+        KW_FORWARD,
+        KW_IF,
+        KW_THEN,
+        KW_ELSE,
+        KW_WHILE,
+        KW_FOR,
+        KW_DO,
+        KW_TO,
+        KW_DOWNTO,
+        KW_READ,
+        KW_WRITE,
+        KW_READLN,
+        KW_WRITELN,
+        KW_EXIT,
+        KW_DEC,
+        KW_INC,
+        KW_DIV,
+        KW_MOD,
+        KW_NOT,
+        KW_AND,
+        KW_OR,
+        KW_ARRAY,
+        KW_OF,
+        KW_INTEGER,
+        KEYWORD_CNT,
+        OP_PLUS = KEYWORD_CNT,
+        OP_MINUS,
+        OP_STAR,
+        OP_SLASH,
+        OP_PERCENT,
+        OP_EQUAL,
+        OP_LESS,
+        OP_GREATER,
+        OP_LESS_EQUAL,
+        OP_GREATER_EQUAL,
+        OP_NOT_EQUAL,
+        OP_ASSIGN,
+        OP_COLON,
+        OP_DOT,
+        OP_DOT_DOT,
+        OP_LEFT_PAREN,
+        OP_RIGHT_PAREN,
+        OP_LEFT_BRACKET,
+        OP_RIGHT_BRACKET,
+        OP_COMMA,
+        OP_SEMICOLON,
+        OP_QUOTE,
+        TK_IDENTIFIER,
+        TK_INTEGER,
+        TK_DIRECTIVE,       // {$name} or {$name number}
+        TK_END_OF_INPUT,
+        TK_ERROR,
+        TOKEN_KIND_CNT
     };
 
+    /// Spelling of every keyword and operator, empty for the other kinds.
+    extern const char * const tokenNames [ TOKEN_KIND_CNT ];
+    TokenKind findKeyword ( const char *, std::size_t );
+    SymbolId kindSymbol ( TokenKind );
+
     enum SymbolType
     {
         IDENTIFIER,
         INTEGER,
         OPERATOR,
         KEYWORD,
+        DIRECTIVE,
         END_OF_INPUT,
         ERROR,
     };
@@ -38,36 +94,85 @@ namespace mila
     struct LexicalSymbol
     {
         LexicalSymbol ( void );
-        LexicalSymbol ( SymbolType );
-        LexicalSymbol ( const std::string & );
-        LexicalSymbol ( const char * );
+        LexicalSymbol ( TokenKind );
         SymbolType type;
-        std::string name;
+        TokenKind kind;
+        SymbolId name;
         int value;
         bool operator == ( const LexicalSymbol & ) const;
         bool operator != ( const LexicalSymbol & ) const;
-        bool operator == ( const char * ) const;
-        bool operator != ( const char * ) const;
+        bool operator == ( TokenKind k ) const { return kind == k; }
+        bool operator != ( TokenKind k ) const { return kind != k; }
         friend std::ostream & operator << ( std::ostream &, const LexicalSymbol & );
     };
 
+    /// SourceBuffer - The whole lexer input in one contiguous block of memory,
+    /// either read from a stream or mapped from a file.
+    class SourceBuffer
+    {
+        public:
+            SourceBuffer ( std::istream & );
+            SourceBuffer ( const char * fileName );
+            SourceBuffer ( SourceBuffer && );
+            SourceBuffer ( const SourceBuffer & ) = delete;
+            SourceBuffer & operator = ( const SourceBuffer & ) = delete;
+            ~SourceBuffer ( void );
+            const char * begin ( void ) const;
+            const char * end ( void ) const;
+            std::size_t size ( void ) const;
+            bool good ( void ) const;
+            /// slice - View of [from, end) that does not own the memory.
+            SourceBuffer slice ( const char * from ) const;
+
+        private:
+            SourceBuffer ( const char * from, const char * to, bool failed );
+            std::vector < char > storage;
+            const char * data;
+            std::size_t length;
+            void * mapping;
+            bool failed;
+    };
+
     class Lexan
     {
         public:
             Lexan ( std::istream && );
+            Lexan ( SourceBuffer && );
             Lexan & operator << ( const LexicalSymbol & );
             Lexan & operator >> ( LexicalSymbol & );
+            const LexicalSymbol & peek ( std::size_t n = 0 );
+            void skip ( void );
             bool eof ( void ) const;
 
+            /// Number of symbols peek can look ahead and operator << can push back.
+            static const std::size_t LOOKAHEAD = 4;
+            std::size_t size ( void ) const;
+            /// position - Where the next symbol will be scanned from. Only
+            /// meaningful while no symbols are buffered.
+            const char * position ( void ) const;
+            /// input - The whole source, whatever was read from it already.
+            const SourceBuffer & input ( void ) const;
+
         private:
-            void clearSpace ( void );
-            void readNumber ( LexicalSymbol &, int );
-            int checkDigit ( char, int, int & );
-            void getNext ( InputCharacter & );
-            void checkKeyword ( LexicalSymbol & );
-            std::istream && input;
-            std::queue < LexicalSymbol > que; 
+            void scan ( LexicalSymbol & );
+            bool clearSpace ( void );
+            void directive ( LexicalSymbol & );
+            void checkKeyword ( LexicalSymbol &, const char *, std::size_t );
+            SourceBuffer source;
+            const char * cur;
+            const char * last;
+            bool atEnd;
+            LexicalSymbol ring [ LOOKAHEAD ];
+            std::size_t head;
+            std::size_t buffered;
     };
+
+    /// lexParallel - Lex the whole source on up to threads threads. The result
+    /// is the symbol sequence Lexan would produce, ending with the first error.
+    /// Chunks are at least minChunk bytes. On one core this is slower than
+    /// Lexan alone, so it is used only when threads are asked for (-j).
+    std::vector < LexicalSymbol > lexParallel ( const SourceBuffer &, unsigned threads,
+                                                std::size_t minChunk = 1 << 16 );
 }
 
 namespace std
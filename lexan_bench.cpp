@@ -0,0 +1,179 @@
+#include "lexan.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+using namespace mila;
+using namespace std;
+
+//==========================================================================
+// Every allocation made while lexing is counted, so that changes which
+// add per-token heap traffic show up next to the throughput numbers.
+static size_t allocations = 0;
+
+void * operator new ( size_t size )
+{
+    allocations ++;
+    if ( void * p = malloc ( size ? size : 1 ) )
+        return p;
+    throw bad_alloc ();
+}
+
+void operator delete ( void * p ) noexcept
+{
+    free ( p );
+}
+
+void operator delete ( void * p, size_t ) noexcept
+{
+    free ( p );
+}
+//==========================================================================
+struct Options
+{
+    size_t megabytes = 16;
+    int identifiers = 50;
+    string bases = "dhox";
+    int compare = 20;
+    unsigned seed = 1;
+    int repeat = 3;
+    const char * dump = nullptr;
+};
+
+/// generate - Synthetic program of roughly the requested size. Operands are
+/// identifiers with the given density, otherwise numbers in one of the
+/// bases ('d' decimal, 'h' $ff, 'o' &17, 'x' 0x1F). Operators are
+/// comparisons and logic with the given share, otherwise arithmetic.
+static string generate ( const Options & opt )
+{
+    mt19937 rng ( opt . seed );
+    auto chance = [&] ( int percent ) { return int ( rng () % 100 ) < percent; };
+
+    vector < string > names;
+    for ( int i = 0 ; i < 1000 ; i ++ )
+    {
+        string name ( 1, 'a' + rng () % 26 );
+        for ( int len = rng () % 12 ; len > 0 ; len -- )
+            name += "abcdefghijklmnopqrstuvwxyz_0123456789" [ rng () % 37 ];
+        names . push_back ( name + to_string ( i ) );
+    }
+    const char * arithmetic [] = { "+", "-", "*", "div", "mod" };
+    const char * comparison [] = { "=", "<>", "<", ">", "<=", ">=", "and", "or" };
+
+    ostringstream os;
+    os << "program bench;\nvar " << names [ 0 ];
+    for ( size_t i = 1 ; i < names . size () ; i ++ )
+        os << ", " << names [ i ];
+    os << " : integer;\nbegin\n";
+
+    size_t target = opt . megabytes << 20;
+    while ( size_t ( os . tellp () ) < target )
+    {
+        os << "    " << names [ rng () % names . size () ] << " := ";
+        for ( int operands = 1 + rng () % 8 ; operands > 0 ; operands -- )
+        {
+            if ( chance ( opt . identifiers ) || opt . bases . empty () )
+                os << names [ rng () % names . size () ];
+            else
+            {
+                unsigned value = rng () % 100000;
+                switch ( opt . bases [ rng () % opt . bases . size () ] )
+                {
+                    case 'h': os << '$' << hex << value << dec; break;
+                    case 'o': os << '&' << oct << value << dec; break;
+                    case 'x': os << "0x" << hex << uppercase << value << nouppercase << dec; break;
+                    default:  os << value; break;
+                }
+            }
+            if ( operands > 1 )
+            {
+                if ( chance ( opt . compare ) )
+                    os << ' ' << comparison [ rng () % 8 ] << ' ';
+                else
+                    os << ' ' << arithmetic [ rng () % 5 ] << ' ';
+            }
+        }
+        os << ";\n";
+    }
+    os << "end.\n";
+    return os . str ();
+}
+
+static void usage ( const char * self )
+{
+    cerr << "usage: " << self << " [-m megabytes] [-i identifier%] [-b bases] [-c comparison%]"
+         << " [-s seed] [-r repeat] [-g file]" << endl
+         << "  bases is any of d (decimal), h ($ff), o (&17) and x (0x1F)" << endl;
+    exit ( 1 );
+}
+
+int main ( int argc, char ** argv )
+{
+    Options opt;
+    for ( int i = 1 ; i < argc ; i ++ )
+    {
+        if ( argv [ i ] [ 0 ] != '-' || i + 1 == argc )
+            usage ( argv [ 0 ] );
+        const char * arg = argv [ ++ i ];
+        switch ( argv [ i - 1 ] [ 1 ] )
+        {
+            case 'm': opt . megabytes = atoi ( arg ); break;
+            case 'i': opt . identifiers = atoi ( arg ); break;
+            case 'b': opt . bases = arg; break;
+            case 'c': opt . compare = atoi ( arg ); break;
+            case 's': opt . seed = atoi ( arg ); break;
+            case 'r': opt . repeat = atoi ( arg ); break;
+            case 'g': opt . dump = arg; break;
+            default: usage ( argv [ 0 ] );
+        }
+    }
+
+    string source = generate ( opt );
+    if ( opt . dump )
+    {
+        ofstream ( opt . dump ) << source;
+        return 0;
+    }
+
+    double best = 0;
+    size_t symbols = 0, allocated = 0;
+    for ( int run = 0 ; run < opt . repeat ; run ++ )
+    {
+        istringstream is ( source );
+        SourceBuffer buffer ( is );
+        Lexan lex ( move ( buffer ) );
+        symbols = 0;
+        size_t before = allocations;
+        auto begin = chrono::steady_clock::now ();
+        LexicalSymbol ls;
+        while ( !lex . eof () )
+        {
+            lex >> ls;
+            if ( ls . type == ERROR )
+            {
+                cerr << ls << endl;
+                return 1;
+            }
+            symbols ++;
+        }
+        double seconds = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+        // The first run also interns every name, later runs only look them up.
+        if ( !run )
+            allocated = allocations - before;
+        if ( !run || seconds < best )
+            best = seconds;
+    }
+
+    cout << source . size () << " bytes, " << symbols << " symbols, best of " << opt . repeat << ": "
+         << best << " s" << endl
+         << source . size () / 1e6 / best << " MB/s, " << symbols / best << " symbols/s, "
+         << double ( allocated ) / symbols << " allocations/symbol in the first run" << endl;
+    return 0;
+}
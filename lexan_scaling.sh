@@ -0,0 +1,20 @@
+#!/bin/bash
+# Lexes one large file sequentially and then with 1, 2, 4, ... threads up to
+# the number of cores and prints the throughput of each run. On one core the
+# chunked lexing is about 30% slower than the sequential one, which is why
+# lexan and parser lex sequentially unless -j is given.
+
+if [ $# -ne 1 ]
+then
+echo "usage: $0 file.p" >&2
+exit 1
+fi
+
+printf "sequential: "
+./lexan -t "$1" > /dev/null || exit 1
+cores=$(nproc)
+for ((jobs = 1; jobs <= cores; jobs *= 2))
+do
+printf '%d threads: ' $jobs
+./lexan -t -j $jobs "$1" > /dev/null || exit 1
+done
@@ -2,38 +2,96 @@
 #include <iostream>
 #include <fstream>
 #include <utility>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
 
 using namespace mila;
 using namespace std;
 
 int main ( int argc, char ** argv )
 {
-    Lexan * tmp;
-    fstream fs;
-    if ( argc > 1 )
+    bool throughput = false;
+    unsigned jobs = 0;
+    size_t chunk = 1 << 16;
+    while ( argc > 1 )
     {
-        fs . open ( argv [ 1 ], fstream::in );
-        tmp = new Lexan ( move ( fs ) );
+        if ( !strcmp ( argv [ 1 ], "-t" ) )
+            throughput = true;
+        else if ( !strcmp ( argv [ 1 ], "-j" ) && argc > 2 )
+        {
+            jobs = atoi ( argv [ 2 ] );
+            argc --;
+            argv ++;
+        }
+        else if ( !strcmp ( argv [ 1 ], "-c" ) && argc > 2 )
+        {
+            chunk = strtoul ( argv [ 2 ], nullptr, 10 );
+            argc --;
+            argv ++;
+        }
+        else
+            break;
+        argc --;
+        argv ++;
     }
-    else
+
+    auto begin = chrono::steady_clock::now ();
+    size_t symbols = 0;
+    size_t bytes;
+    if ( jobs )
     {
-        tmp =  new Lexan ( move ( cin ) );
+        SourceBuffer source = argc > 1 ? SourceBuffer ( argv [ 1 ] ) : SourceBuffer ( cin );
+        bytes = source . size ();
+        for ( const LexicalSymbol & ls : lexParallel ( source, jobs, chunk ) )
+        {
+            if ( ls . type == ERROR )
+            {
+                cerr << ls << endl;
+                return 1;
+            }
+            symbols ++;
+            if ( !throughput )
+                cout << ls << endl;
+        }
     }
-    Lexan & lex = *tmp;
-
-    LexicalSymbol ls;
-    while ( !lex . eof () )
+    else
     {
-        lex >> ls;
+        Lexan * tmp;
+        if ( argc > 1 )
+        {
+            tmp = new Lexan ( SourceBuffer ( argv [ 1 ] ) );
+        }
+        else
+        {
+            tmp =  new Lexan ( move ( cin ) );
+        }
+        Lexan & lex = *tmp;
 
-        if ( ls . type == ERROR )
+        LexicalSymbol ls;
+        while ( !lex . eof () )
         {
-            cerr << ls << endl;
-            return 1;
+            lex >> ls;
+
+            if ( ls . type == ERROR )
+            {
+                cerr << ls << endl;
+                return 1;
+            }
+            symbols ++;
+            if ( !throughput )
+                cout << ls << endl;
         }
-        cout << ls << endl;
+        bytes = lex . size ();
+        delete tmp;
+    }
+
+    if ( throughput )
+    {
+        double seconds = chrono::duration < double > ( chrono::steady_clock::now () - begin ) . count ();
+        double megabytes = bytes / 1e6;
+        cerr << symbols << " symbols, " << bytes << " bytes in " << seconds << " s: "
+             << megabytes / seconds << " MB/s, " << symbols / seconds << " symbols/s" << endl;
     }
-    delete tmp;
-    fs . close ();
     return 0;
 }
@@ -0,0 +1,19 @@
+#!/bin/bash
+# Times lexing, parsing, folding and codegen of a main block nested 10^3, 10^4
+# and 10^5 deep, one process per depth. Nothing in the compiler recurses on
+# the thread stack, so the deepest one has to pass too, the ns/byte columns
+# should stay flat and the peak memory grow with the bytes only. Any arguments
+# go to compile_bench.
+
+printf "%7s %10s %9s %9s | %9s %7s | %9s %7s | %9s %7s | %9s %7s | %10s %9s\n" \
+    depth bytes symbols nodes lex ns/B parse ns/B fold ns/B codegen ns/B "ast bytes" "peak kB"
+for depth in 1000 10000 100000
+do
+if ! row=$(./compile_bench -n $depth "$@")
+then
+echo "compile_bench failed at depth $depth" >&2
+exit 1
+fi
+echo "$row" | awk '{ printf "%7d %10d %9d %9d | %9.4f %7.2f | %9.4f %7.2f | %9.4f %7.2f | %9.4f %7.2f | %10d %9d\n",
+    $1, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14, $18 }'
+done
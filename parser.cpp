@@ -1,12 +1,20 @@
 #include "lexan.h"
 #include "parser.h"
+#include "codegen.h"
 #include <iostream>
 #include <string>
-#include <map>
-#include <list>
-#include <unordered_set>
 #include <sstream>
 #include <utility>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <thread>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 //#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Bitcode/BitcodeReader.h"
@@ -15,109 +23,509 @@
 
 using namespace mila;
 
-//=========================================================
-mila::LLSymbol::LLSymbol ( const LexicalSymbol & ls )
-: terminal ( ls )
-{
-    type = TERMINAL;
-}
+extern char ** environ;
 
-mila::LLSymbol::LLSymbol ( const std::string & str )
-: terminal ( LexicalSymbol ( str ) )
-{
-    type = TERMINAL;
-}
+// The C compiler which links executables when $CC is not set, and the object
+// of inc.c linked into them. The Makefile passes both, the object as an
+// absolute path so that the parser links from any directory.
+#ifndef MILA_CC
+#define MILA_CC "cc"
+#endif
+#ifndef MILA_RUNTIME
+#define MILA_RUNTIME "binary/inc.o"
+#endif
 
-mila::LLSymbol::LLSymbol ( const char * str )
-: terminal ( LexicalSymbol ( str ) )
+namespace
 {
-    type = TERMINAL;
-}
+    /// Parse stack symbols past the token kinds. TEXT_TOKEN matches any token
+    /// but the closing quote of write.
+    const LLSymbol TEXT_TOKEN = TOKEN_KIND_CNT;
+    const LLSymbol FIRST_NONTERMINAL = TEXT_TOKEN + 1;
+    const LLSymbol FIRST_ACTION = FIRST_NONTERMINAL + NONTERM_CNT;
+    static_assert ( FIRST_ACTION + ACTION_CNT <= 256, "Parse stack symbols must fit LLSymbol." );
 
-mila::LLSymbol::LLSymbol ( Nonterminal nonterm )
-: nonterminal ( nonterm )
-{
-    type = NONTERMINAL;
-}
+    constexpr TokenSet TEXT_TOKENS = TokenSet::all () - TokenSet { OP_QUOTE, TK_END_OF_INPUT };
 
-bool mila::LLSymbol::isTerminal ( void ) const
-{
-    return type == TERMINAL;
-}
+    constexpr LLSymbol N ( Nonterminal nonterminal )
+    {
+        return FIRST_NONTERMINAL + nonterminal;
+    }
 
-bool mila::LLSymbol::isNonterminal ( void ) const
-{
-    return type == NONTERMINAL;
-}
+    constexpr LLSymbol A ( Action action )
+    {
+        return FIRST_ACTION + action;
+    }
 
-bool mila::LLSymbol::operator == ( const LLSymbol & lls ) const
-{
-    if ( this -> type != lls . type )
-        return false;
-    if ( this -> type == TERMINAL )
-        return this -> terminal == lls . terminal;
-    return this -> nonterminal == lls . nonterminal;
-}
+    const int MAX_RHS = 14;
 
-bool mila::LLSymbol::operator != ( const LLSymbol & lls ) const
-{
-    return !( *this == lls );
-}
+    struct Production
+    {
+        Nonterminal lhs;
+        int length;
+        LLSymbol rhs [ MAX_RHS ];
+    };
 
-bool mila::LLSymbol::operator == ( const LexicalSymbol & ls ) const
-{
-    if ( this -> type != TERMINAL )
-        return false;
-    return this -> terminal == ls;
-}
+    constexpr Production rule ( Nonterminal lhs, std::initializer_list < LLSymbol > rhs )
+    {
+        Production production { lhs, 0, {} };
+        for ( LLSymbol symbol : rhs )
+            production . rhs [ production . length ++ ] = symbol;
+        return production;
+    }
 
-bool mila::LLSymbol::operator != ( const LexicalSymbol & ls ) const
-{
-    return !( *this == ls );
-}
+    /// grammar - The Mila grammar. Actions are transparent to the parse, they
+    /// only run when they are popped. Statements may be separated by ';'.
+    /// Directives go before a loop, an if or a routine.
+    constexpr Production grammar [] =
+    {
+        rule ( PROGRAM,         { KW_PROGRAM, TK_IDENTIFIER, A ( A_NAME ), OP_SEMICOLON,
+                                  A ( A_MARK ), N ( DECLARATIONS ), A ( A_LIST ), N ( BLOCK ), OP_DOT, A ( A_PROGRAM ) } ),
+
+        rule ( DECLARATIONS,    { N ( DECLARATION ), N ( DECLARATIONS ) } ),
+        rule ( DECLARATIONS,    {} ),
+        rule ( DECLARATION,     { KW_VAR, A ( A_MARK ), N ( VARIABLES ), A ( A_LIST ) } ),
+        rule ( DECLARATION,     { KW_CONST, A ( A_MARK ), N ( CONSTANTS ), A ( A_LIST ) } ),
+        rule ( DECLARATION,     { N ( ROUTINE ) } ),
+        rule ( DECLARATION,     { A ( A_DIRECTIVES ), TK_DIRECTIVE, A ( A_DIRECTIVE ), N ( DIRECTIVES ), N ( ROUTINE ),
+                                  A ( A_DIRECT ) } ),
+        rule ( ROUTINE,         { KW_FUNCTION, TK_IDENTIFIER, A ( A_NAME ), A ( A_MARK_NAMES ), N ( PARAMETERS ),
+                                  OP_COLON, KW_INTEGER, OP_SEMICOLON, A ( A_PROTOTYPE ), N ( FUNCTION_BODY ) } ),
+        rule ( ROUTINE,         { KW_PROCEDURE, TK_IDENTIFIER, A ( A_NAME ), A ( A_MARK_NAMES ), N ( PARAMETERS ),
+                                  OP_SEMICOLON, A ( A_PROTOTYPE ), N ( PROCEDURE_BODY ) } ),
+
+        rule ( VARIABLES,       { N ( VARIABLE_GROUP ), N ( VARIABLES_REST ) } ),
+        rule ( VARIABLES_REST,  { N ( VARIABLE_GROUP ), N ( VARIABLES_REST ) } ),
+        rule ( VARIABLES_REST,  {} ),
+        rule ( VARIABLE_GROUP,  { A ( A_MARK_NAMES ), TK_IDENTIFIER, A ( A_NAME ), N ( NAMES_REST ), OP_COLON,
+                                  N ( VARIABLE_TYPE ), OP_SEMICOLON } ),
+        rule ( NAMES_REST,      { OP_COMMA, TK_IDENTIFIER, A ( A_NAME ), N ( NAMES_REST ) } ),
+        rule ( NAMES_REST,      {} ),
+        rule ( VARIABLE_TYPE,   { KW_INTEGER, A ( A_DECLARE ) } ),
+        rule ( VARIABLE_TYPE,   { KW_ARRAY, OP_LEFT_BRACKET, N ( NUMBER ), OP_DOT_DOT, N ( NUMBER ), OP_RIGHT_BRACKET,
+                                  KW_OF, KW_INTEGER, A ( A_DECLARE_ARRAY ) } ),
+        rule ( NUMBER,          { OP_MINUS, TK_INTEGER, A ( A_NUMBER ), A ( A_NEGATE ) } ),
+        rule ( NUMBER,          { TK_INTEGER, A ( A_NUMBER ) } ),
+
+        rule ( CONSTANTS,       { N ( CONSTANT ), N ( CONSTANTS_REST ) } ),
+        rule ( CONSTANTS_REST,  { N ( CONSTANT ), N ( CONSTANTS_REST ) } ),
+        rule ( CONSTANTS_REST,  {} ),
+        rule ( CONSTANT,        { TK_IDENTIFIER, A ( A_NAME ), OP_EQUAL, N ( NUMBER ), OP_SEMICOLON, A ( A_CONSTANT ) } ),
+
+        rule ( PARAMETERS,      { OP_LEFT_PAREN, N ( PARAMETER_LIST ), OP_RIGHT_PAREN } ),
+        rule ( PARAMETER_LIST,  { N ( PARAMETER ), N ( PARAMETER_REST ) } ),
+        rule ( PARAMETER_REST,  { OP_SEMICOLON, N ( PARAMETER ), N ( PARAMETER_REST ) } ),
+        rule ( PARAMETER_REST,  {} ),
+        rule ( PARAMETER,       { TK_IDENTIFIER, A ( A_NAME ), OP_COLON, KW_INTEGER } ),
+        rule ( FUNCTION_BODY,   { KW_FORWARD, OP_SEMICOLON, A ( A_FORWARD ) } ),
+        rule ( FUNCTION_BODY,   { A ( A_MARK ), N ( LOCALS ), N ( BLOCK ), OP_SEMICOLON, A ( A_FUNCTION ) } ),
+        rule ( PROCEDURE_BODY,  { KW_FORWARD, OP_SEMICOLON, A ( A_FORWARD ) } ),
+        rule ( PROCEDURE_BODY,  { A ( A_MARK ), N ( LOCALS ), N ( BLOCK ), OP_SEMICOLON, A ( A_PROCEDURE ) } ),
+        rule ( LOCALS,          { KW_VAR, A ( A_MARK ), N ( VARIABLES ), A ( A_LIST ), N ( LOCALS ) } ),
+        rule ( LOCALS,          {} ),
+
+        rule ( BLOCK,           { KW_BEGIN, A ( A_MARK ), N ( STATEMENT ), N ( AFTER_STATEMENT ), KW_END, A ( A_LIST ) } ),
+        rule ( AFTER_STATEMENT, { OP_SEMICOLON, N ( NEXT_STATEMENT ) } ),
+        rule ( AFTER_STATEMENT, { N ( NEXT_STATEMENT ) } ),
+        rule ( NEXT_STATEMENT,  { N ( STATEMENT ), N ( AFTER_STATEMENT ) } ),
+        rule ( NEXT_STATEMENT,  {} ),
+        rule ( STATEMENT,       { N ( COMMAND ) } ),
+        rule ( STATEMENT,       { N ( CONTROL ) } ),
+        rule ( STATEMENT,       { A ( A_DIRECTIVES ), TK_DIRECTIVE, A ( A_DIRECTIVE ), N ( DIRECTIVES ), N ( CONTROL ),
+                                  A ( A_DIRECT ) } ),
+        rule ( DIRECTIVES,      { TK_DIRECTIVE, A ( A_DIRECTIVE ), N ( DIRECTIVES ) } ),
+        rule ( DIRECTIVES,      {} ),
+
+        rule ( COMMAND,         { KW_WRITE, OP_LEFT_PAREN, OP_QUOTE, N ( TEXT ), OP_QUOTE, OP_RIGHT_PAREN, A ( A_ZERO ) } ),
+        rule ( COMMAND,         { TK_IDENTIFIER, A ( A_NAME ), N ( ASSIGN_OR_CALL ) } ),
+        rule ( COMMAND,         { KW_WRITELN, A ( A_NAME ), N ( ARGUMENTS ), A ( A_CALL ) } ),
+        rule ( COMMAND,         { KW_READLN, A ( A_NAME ), OP_LEFT_PAREN, TK_IDENTIFIER, A ( A_NAME ), OP_RIGHT_PAREN,
+                                  A ( A_LIBRARY ) } ),
+        rule ( COMMAND,         { KW_INC, A ( A_NAME ), OP_LEFT_PAREN, TK_IDENTIFIER, A ( A_NAME ), OP_RIGHT_PAREN,
+                                  A ( A_LIBRARY ) } ),
+        rule ( COMMAND,         { KW_DEC, A ( A_NAME ), OP_LEFT_PAREN, TK_IDENTIFIER, A ( A_NAME ), OP_RIGHT_PAREN,
+                                  A ( A_LIBRARY ) } ),
+        rule ( COMMAND,         { KW_EXIT, A ( A_RETURN ) } ),
+        rule ( TEXT,            { TEXT_TOKEN, N ( TEXT ) } ),
+        rule ( TEXT,            {} ),
+        rule ( ASSIGN_OR_CALL,  { OP_LEFT_BRACKET, N ( EXPRESSION ), OP_RIGHT_BRACKET, A ( A_INDEX ), OP_ASSIGN,
+                                  N ( EXPRESSION ), A ( A_ASSIGN ) } ),
+        rule ( ASSIGN_OR_CALL,  { A ( A_VARIABLE ), OP_ASSIGN, N ( EXPRESSION ), A ( A_ASSIGN ) } ),
+        rule ( ASSIGN_OR_CALL,  { N ( ARGUMENTS ), A ( A_CALL ) } ),
+        rule ( ARGUMENTS,       { OP_LEFT_PAREN, A ( A_MARK ), N ( EXPRESSION ), N ( ARGUMENTS_REST ), OP_RIGHT_PAREN } ),
+        rule ( ARGUMENTS_REST,  { OP_COMMA, N ( EXPRESSION ), N ( ARGUMENTS_REST ) } ),
+        rule ( ARGUMENTS_REST,  {} ),
+
+        rule ( CONTROL,         { KW_IF, N ( EXPRESSION ), KW_THEN, N ( BLOCK_COMMAND ), N ( ELSE_PART ), A ( A_IF ) } ),
+        rule ( CONTROL,         { KW_FOR, TK_IDENTIFIER, A ( A_NAME ), OP_ASSIGN, N ( EXPRESSION ), N ( DIRECTION ),
+                                  N ( EXPRESSION ), KW_DO, N ( BLOCK_COMMAND ), A ( A_FOR ) } ),
+        rule ( CONTROL,         { KW_WHILE, N ( EXPRESSION ), KW_DO, N ( BLOCK_COMMAND ), A ( A_WHILE ) } ),
+        rule ( ELSE_PART,       { KW_ELSE, N ( BLOCK_COMMAND ) } ),
+        rule ( ELSE_PART,       { A ( A_ZERO ) } ),
+        rule ( DIRECTION,       { KW_TO, A ( A_STEP_UP ) } ),
+        rule ( DIRECTION,       { KW_DOWNTO, A ( A_STEP_DOWN ) } ),
+        rule ( BLOCK_COMMAND,   { N ( BLOCK ) } ),
+        rule ( BLOCK_COMMAND,   { N ( COMMAND ) } ),
+
+        rule ( EXPRESSION,      { A ( A_EXPRESSION ), N ( OPERAND ), N ( EXPRESSION_REST ), A ( A_END_EXPRESSION ) } ),
+        rule ( EXPRESSION_REST, { N ( BINARY_OPERATOR ), N ( OPERAND ), N ( EXPRESSION_REST ) } ),
+        rule ( EXPRESSION_REST, {} ),
+        rule ( BINARY_OPERATOR, { OP_PLUS, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_MINUS, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_STAR, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { KW_DIV, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { KW_MOD, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_EQUAL, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_NOT_EQUAL, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_LESS, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_LESS_EQUAL, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_GREATER, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { OP_GREATER_EQUAL, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { KW_AND, A ( A_OPERATOR ) } ),
+        rule ( BINARY_OPERATOR, { KW_OR, A ( A_OPERATOR ) } ),
+        rule ( OPERAND,         { N ( NUMBER ), A ( A_LITERAL ) } ),
+        rule ( OPERAND,         { TK_IDENTIFIER, A ( A_NAME ), N ( OPERAND_SUFFIX ) } ),
+        rule ( OPERAND,         { OP_LEFT_PAREN, N ( EXPRESSION ), OP_RIGHT_PAREN } ),
+        rule ( OPERAND_SUFFIX,  { OP_LEFT_BRACKET, N ( EXPRESSION ), OP_RIGHT_BRACKET, A ( A_INDEX ) } ),
+        rule ( OPERAND_SUFFIX,  { N ( ARGUMENTS ), A ( A_CALL ) } ),
+        rule ( OPERAND_SUFFIX,  { A ( A_VARIABLE ) } ),
+    };
+
+    const int RULE_CNT = sizeof ( grammar ) / sizeof ( grammar [ 0 ] );
+    const signed char NO_RULE = -1;
+    static_assert ( RULE_CNT < 128, "Rule numbers must fit the parse table." );
+
+    /// What each nonterminal can start with, for the error messages.
+    const char * const expecting [ NONTERM_CNT ] =
+    {
+        "'program'",
+        "Declarations or 'begin'",
+        "Declarations",
+        "'function' or 'procedure'",
+        "identifier",
+        "'var', 'const', 'function', 'procedure', 'begin' or identifier",
+        "identifier",
+        "':' or ','",
+        "'integer' or 'array'",
+        "number",
+        "identifier",
+        "'var', 'const', 'function', 'procedure', 'begin' or identifier",
+        "identifier",
+        "'('",
+        "identifier",
+        "';' or ')'",
+        "identifier",
+        "'forward', 'var' or 'begin'",
+        "'forward', 'var' or 'begin'",
+        "'var' or 'begin'",
+        "'begin'",
+        "Statement or 'end'",
+        "Statement or 'end'",
+        "Statement or 'end'",
+        "Directive, 'if', 'for', 'while', 'function' or 'procedure'",
+        "Command",
+        "Text or \"'\"",
+        "'[', '(' or ':='",
+        "'('",
+        "',' or ')'",
+        "'if', 'for' or 'while'",
+        "'else' or end of statement",
+        "'to' or 'downto'",
+        "'begin' or command",
+        "Number, identifier or '('",
+        "Operator or end of expression",
+        "Operator",
+        "Number, identifier or '('",
+        "'[', '(', operator or end of expression",
+    };
+
+    /// ParseTables - FIRST and FOLLOW sets of the grammar and the LL(1) table
+    /// built from them, all at compile time. A cell claimed by two rules
+    /// marks the grammar as not LL(1).
+    struct ParseTables
+    {
+        TokenSet first [ NONTERM_CNT ];
+        TokenSet follow [ NONTERM_CNT ];
+        bool nullable [ NONTERM_CNT ];
+        signed char rules [ NONTERM_CNT ] [ TOKEN_KIND_CNT ];
+        LLSymbol pushes [ RULE_CNT ] [ MAX_RHS ];   // right hand sides in the order they are pushed
+        bool conflict;
+
+        constexpr ParseTables ( void )
+        : first (), follow (), nullable (), rules (), pushes (), conflict ( false )
+        {
+            for ( int r = 0 ; r < RULE_CNT ; r ++ )
+                for ( int i = 0 ; i < grammar [ r ] . length ; i ++ )
+                    pushes [ r ] [ i ] = grammar [ r ] . rhs [ grammar [ r ] . length - 1 - i ];
 
-bool mila::LLSymbol::operator == ( const Nonterminal & nt ) const
-{
-    if ( this -> type != NONTERMINAL )
-        return false;
-    return this -> nonterminal == nt;
-}
+            bool changed = true;
+            while ( changed )
+            {
+                changed = false;
+                for ( const Production & production : grammar )
+                {
+                    bool empty = true;
+                    TokenSet set = first [ production . lhs ] | sequence ( production, 0, empty );
+                    if ( set != first [ production . lhs ] || ( empty && !nullable [ production . lhs ] ) )
+                        changed = true;
+                    first [ production . lhs ] = set;
+                    nullable [ production . lhs ] = nullable [ production . lhs ] || empty;
+                }
+            }
 
-bool mila::LLSymbol::operator != ( const Nonterminal & nt ) const
-{
-    return !( *this == nt );
-}
+            follow [ PROGRAM ] = TokenSet { TK_END_OF_INPUT };
+            changed = true;
+            while ( changed )
+            {
+                changed = false;
+                for ( const Production & production : grammar )
+                    for ( int i = 0 ; i < production . length ; i ++ )
+                    {
+                        if ( !isNonterminal ( production . rhs [ i ] ) )
+                            continue;
+                        Nonterminal nonterminal = Nonterminal ( production . rhs [ i ] - FIRST_NONTERMINAL );
+                        bool empty = true;
+                        TokenSet set = follow [ nonterminal ] | sequence ( production, i + 1, empty );
+                        if ( empty )
+                            set = set | follow [ production . lhs ];
+                        if ( set != follow [ nonterminal ] )
+                            changed = true;
+                        follow [ nonterminal ] = set;
+                    }
+            }
 
-namespace mila
-{
-    bool operator == ( const LexicalSymbol & ls, const LLSymbol & lls )
+            for ( int nonterminal = 0 ; nonterminal < NONTERM_CNT ; nonterminal ++ )
+                for ( int kind = 0 ; kind < TOKEN_KIND_CNT ; kind ++ )
+                    rules [ nonterminal ] [ kind ] = NO_RULE;
+            for ( int r = 0 ; r < RULE_CNT ; r ++ )
+            {
+                const Production & production = grammar [ r ];
+                bool empty = true;
+                TokenSet set = sequence ( production, 0, empty );
+                if ( empty )
+                    set = set | follow [ production . lhs ];
+                for ( int kind = 0 ; kind < TOKEN_KIND_CNT ; kind ++ )
+                {
+                    if ( !set . contains ( TokenKind ( kind ) ) )
+                        continue;
+                    if ( rules [ production . lhs ] [ kind ] != NO_RULE )
+                        conflict = true;
+                    rules [ production . lhs ] [ kind ] = r;
+                }
+            }
+        }
+
+        static constexpr bool isNonterminal ( LLSymbol symbol )
+        {
+            return symbol >= FIRST_NONTERMINAL && symbol < FIRST_ACTION;
+        }
+
+        /// sequence - FIRST of the right hand side from position from on;
+        /// empty is cleared when it cannot derive the empty string.
+        constexpr TokenSet sequence ( const Production & production, int from, bool & empty ) const
+        {
+            TokenSet set;
+            for ( int i = from ; i < production . length && empty ; i ++ )
+            {
+                LLSymbol symbol = production . rhs [ i ];
+                if ( symbol < TEXT_TOKEN )
+                {
+                    set = set | TokenSet { TokenKind ( symbol ) };
+                    empty = false;
+                }
+                else if ( symbol == TEXT_TOKEN )
+                {
+                    set = set | TEXT_TOKENS;
+                    empty = false;
+                }
+                else if ( isNonterminal ( symbol ) )
+                {
+                    set = set | first [ symbol - FIRST_NONTERMINAL ];
+                    empty = nullable [ symbol - FIRST_NONTERMINAL ];
+                }
+            }
+            return set;
+        }
+
+        /// valid - The grammar is LL(1) and every nonterminal derives something.
+        constexpr bool valid ( void ) const
+        {
+            if ( conflict )
+                return false;
+            for ( int nonterminal = 0 ; nonterminal < NONTERM_CNT ; nonterminal ++ )
+                if ( first [ nonterminal ] == TokenSet () && !nullable [ nonterminal ] )
+                    return false;
+            return true;
+        }
+    };
+
+    constexpr ParseTables parseTables;
+    static_assert ( parseTables . valid (), "The grammar is not LL(1)." );
+
+    bool matches ( LLSymbol symbol, TokenKind kind )
     {
-        return lls == ls;
+        return symbol == TEXT_TOKEN ? TEXT_TOKENS . contains ( kind ) : symbol == kind;
     }
 
-    bool operator != ( const LexicalSymbol & ls, const LLSymbol & lls )
+    /// Routine - Name of a routine and the token range of its body.
+    struct Routine
+    {
+        SymbolId name;
+        std::size_t first;
+        std::size_t last;
+    };
+
+    /// routineBodies - Token ranges of the function and procedure bodies,
+    /// from the locals to the 'end' matching the first 'begin'. The text of
+    /// write may hold 'begin' and 'end', it is skipped. On malformed input
+    /// ranges can be wrong, the parser checks them. main is set to where the
+    /// main block begins.
+    std::vector < Routine > routineBodies ( const std::vector < LexicalSymbol > & tokens, std::size_t & main )
+    {
+        std::vector < Routine > ranges;
+        std::size_t i = 0, n = tokens . size ();
+        // declarations end at the main block
+        while ( i < n && tokens [ i ] . kind != KW_BEGIN )
+        {
+            if ( tokens [ i ] . kind != KW_FUNCTION && tokens [ i ] . kind != KW_PROCEDURE )
+            {
+                i ++;
+                continue;
+            }
+            SymbolId name = i + 1 < n ? tokens [ i + 1 ] . name : 0;
+            // the heading ends with the first ';' outside the parameters
+            int parens = 0;
+            for ( ; i < n ; i ++ )
+            {
+                TokenKind kind = tokens [ i ] . kind;
+                if ( kind == OP_LEFT_PAREN )
+                    parens ++;
+                else if ( kind == OP_RIGHT_PAREN )
+                    parens --;
+                else if ( kind == OP_SEMICOLON && parens <= 0 )
+                    break;
+            }
+            std::size_t first = ++ i;
+            if ( i >= n || tokens [ i ] . kind == KW_FORWARD )
+                continue;
+            while ( i < n && tokens [ i ] . kind != KW_BEGIN )
+                i ++;
+            int depth = 0;
+            bool text = false;
+            for ( ; i < n ; i ++ )
+            {
+                TokenKind kind = tokens [ i ] . kind;
+                if ( kind == OP_QUOTE )
+                    text = !text;
+                else if ( text )
+                    continue;
+                else if ( kind == KW_BEGIN )
+                    depth ++;
+                else if ( kind == KW_END && -- depth == 0 )
+                    break;
+            }
+            if ( i == n )
+                break;
+            ranges . push_back ( Routine { name, first, ++ i } );
+        }
+        main = i;
+        return ranges;
+    }
+
+    /// calls - Add the names called in tokens [first, last) to callees. A
+    /// call is a name followed by '(' outside the text of write.
+    void calls ( const std::vector < LexicalSymbol > & tokens, std::size_t first, std::size_t last,
+                 std::vector < SymbolId > & callees )
+    {
+        bool text = false;
+        for ( std::size_t i = first ; i + 1 < last ; i ++ )
+        {
+            if ( tokens [ i ] . kind == OP_QUOTE )
+                text = !text;
+            else if ( !text && tokens [ i ] . kind == TK_IDENTIFIER && tokens [ i + 1 ] . kind == OP_LEFT_PAREN )
+                callees . push_back ( tokens [ i ] . name );
+        }
+    }
+
+    const LexicalSymbol & endOfInput ( void )
+    {
+        static const LexicalSymbol end ( TK_END_OF_INPUT );
+        return end;
+    }
 
+    OperEnum binaryOperator ( TokenKind kind )
     {
-        return !( lls == ls );
+        switch ( kind )
+        {
+            case OP_PLUS:           return ADD;
+            case OP_MINUS:          return SUB;
+            case OP_STAR:           return MULT;
+            case KW_DIV:            return DIV;
+            case KW_MOD:            return MOD;
+            case OP_EQUAL:          return EQ;
+            case OP_LESS:           return LT;
+            case OP_GREATER:        return GT;
+            case OP_LESS_EQUAL:     return LE;
+            case OP_GREATER_EQUAL:  return GE;
+            case OP_NOT_EQUAL:      return NE;
+            case KW_AND:            return AND;
+            default:                return OR;
+        }
     }
 
-    bool operator == ( const Nonterminal & nt, const LLSymbol & lls )
+    /// linkExecutable - Link object with the runtime MILA_RUNTIME into
+    /// executable. The C compiler drives the linker, $CC when it is set and
+    /// MILA_CC otherwise, it is the only process started.
+    void linkExecutable ( const std::string & object, const char * executable )
     {
-        return lls == nt;
+        const char * cc = getenv ( "CC" );
+        if ( !cc || !*cc )
+            cc = MILA_CC;
+        if ( access ( MILA_RUNTIME, R_OK ) )
+            throw ParserException ( std::string ( "Could not read the runtime " ) + MILA_RUNTIME + ": "
+                                    + strerror ( errno ) + "." );
+        const char * args [] = { cc, object . c_str (), MILA_RUNTIME, "-o", executable, nullptr };
+        pid_t pid;
+        int status;
+        int error = posix_spawnp ( &pid, cc, nullptr, nullptr, const_cast < char ** > ( args ), environ );
+        if ( error )
+            throw ParserException ( std::string ( "Could not start " ) + cc + ": " + strerror ( error ) + "." );
+        if ( waitpid ( pid, &status, 0 ) < 0 )
+            throw ParserException ( std::string ( "Waiting for " ) + cc + " failed: " + strerror ( errno ) + "." );
+        if ( !WIFEXITED ( status ) || WEXITSTATUS ( status ) )
+            throw ParserException ( "Linking failed." );
     }
 
-    bool operator != ( const Nonterminal & nt, const LLSymbol & lls )
+    /// direct - Record the directive ls in directives. False for an unknown
+    /// one or a number it does not take.
+    bool direct ( Directives & directives, const LexicalSymbol & ls )
     {
-        return !( lls == nt );
+        const std::string name = symbolName ( ls . name );
+        if ( name == "unroll" || name == "vectorize" )
+        {
+            ( name == "unroll" ? directives . unroll : directives . vectorize ) = ls . value;
+            return ls . value != 0;
+        }
+        if ( ls . value != -1 )
+            return false;
+        if ( name == "inline" || name == "noinline" )
+            directives . inlining = name == "inline" ? 1 : -1;
+        else if ( name == "likely" || name == "unlikely" )
+            directives . likely = name == "likely" ? 1 : -1;
+        else
+            return false;
+        return true;
     }
 
-    std::ostream & operator << ( std::ostream & os, const LLSymbol & lls )
+    /// misplaced - Directives ask for what a node of kind does not have.
+    bool misplaced ( NodeKind kind, const Directives & directives )
     {
-        if ( lls . type == TERMINAL )
-            return os << lls . terminal;
-        return os << lls . nonterminal;
+        bool loop = kind == NODE_FOR || kind == NODE_WHILE;
+        bool routine = kind == NODE_FUNCTION || kind == NODE_PROTOTYPE;
+        return ( ( directives . unroll || directives . vectorize ) && !loop )
+            || ( directives . inlining && !routine ) || ( directives . likely && kind != NODE_IF );
     }
 }
+
 //=========================================================
 mila::ParserException::ParserException ( const std::string & error )
 : message ( error )
@@ -132,88 +540,30 @@ namespace mila
     }
 }
 //#########################################################
-mila::Parser::Parser ( Lexan && lex )
-: expected ( 1, LLSymbol ( START ) ),
-parseNonterm
-{
-    &Parser::start,
-    &Parser::ident,
-    //&Parser::arrayOrParam,
-    //&Parser::array,
-    //&Parser::functionParams,
-    //&Parser::minusNumb,
-    //&Parser::numb,
-    //&Parser::value,
-    //&Parser::positiveValue,
-    &Parser::expression,
-    //&Parser::expression2,
-    //&Parser::operation,
-    //&Parser::type,
-    //&Parser::declarations,
-    &Parser::block,
-    &Parser::variable,
-    //&Parser::variable2,
-    //&Parser::variable3,
-    &Parser::constant,
-    &Parser::constant2,
-    &Parser::function,
-    &Parser::procedure,
-    //&Parser::parameters,
-    //&Parser::parameters2,
-    //&Parser::definition,
-    //&Parser::statement,
-    //&Parser::nextStatement,
-    //&Parser::nextStatement2,
-    &Parser::command,
-    //&Parser::control,
-    //&Parser::blockOrCommand,
-    //&Parser::ifElseIf,
-    //&Parser::ifElse,
-    //&Parser::toDownto,
-    //&Parser::param,
-    //&Parser::param2,
-    //&Parser::assign,
-    //&Parser::foo
-},
-lex ( std::move ( lex ) )
-{
-}
-
-void mila::Parser::printQue ( std::ostream & os ) const
+mila::Parser::Parser ( Lexan && lex, unsigned threads, bool lazy, unsigned level, bool folding )
+: threads ( threads ), lazy ( lazy ), level ( level ), folding ( folding ), cursor ( nullptr ), limit ( nullptr ), nextBody ( 0 ), lex ( std::move ( lex ) )
 {
-    for ( auto it : expected )
-        os << it << std::endl;
 }
 
-void mila::Parser::expect ( tokenList && next )
+/// Parser of the symbols [first, last) only, used for one routine body.
+mila::Parser::Parser ( const LexicalSymbol * first, const LexicalSymbol * last )
+: threads ( 1 ), lazy ( false ), level ( 0 ), folding ( true ), cursor ( first ), limit ( last ), nextBody ( 0 ), lex ( std::istringstream () )
 {
-    expected . pop_front ();
-    expected . splice ( expected . begin (), next );
-std::cerr << "EXPECTING" << std::endl;
 }
 
-int mila::Parser::readNumber ( void )
+const LexicalSymbol & mila::Parser::peek ( void )
 {
-    LexicalSymbol ls;
-    lex >> ls;
-    int i = 1;
-    if ( ls == "-" )
-    {
-        i *= -1;
-        lex >> ls;
-    }
-    if ( ls . type != INTEGER )
-        parserError ( "number", ls );
-    i *= ls . value;
-    return i;
+    if ( !limit )
+        return lex . peek ();
+    return cursor < limit ? *cursor : endOfInput ();
 }
 
-std::string mila::Parser::readIdentifier ( void )
+void mila::Parser::read ( void )
 {
-    LexicalSymbol ls = getNextLS ();
-    if ( ls . type != IDENTIFIER )
-        parserError ( "identifier", ls );
-    return ls . name;
+    if ( !limit )
+        lex >> previous;
+    else
+        previous = cursor < limit ? *cursor ++ : endOfInput ();
 }
 
 void mila::Parser::parserError ( const char * expected, const LexicalSymbol & read ) const
@@ -230,762 +580,489 @@ void mila::Parser::parserError ( const LexicalSymbol & expected, const LexicalSy
             throw ParserException ( error . str () );
 }
 
-LexicalSymbol mila::Parser::getNextLS ( void )
-{
-    LexicalSymbol ls;
-    lex >> ls;
-    return ls;
-}
 
-LexicalSymbol mila::Parser::peekNextLS ( void )
+NodeId mila::Parser::popNode ( void )
 {
-    LexicalSymbol ls;
-    lex >> ls;
-    lex << ls;
-    return ls;
+    NodeId node = nodes . back ();
+    nodes . pop_back ();
+    return node;
 }
 
-void mila::Parser::parse ( void )
+/// popChildren - Make a node whose children are the nodes from first up.
+NodeId mila::Parser::popChildren ( NodeKind kind, std::uint32_t head, std::size_t first )
 {
-    start ( getNextLS () );
+    NodeId node = ast . add ( kind, head, nodes . data () + first, nodes . data () + nodes . size () );
+    nodes . resize ( first );
+    return node;
 }
 
-int mila::Parser::parseSymbol ( const LexicalSymbol & ls )
+NodeId mila::Parser::popList ( NodeKind kind, std::uint32_t head )
 {
-    if ( expected . empty () )
-    {
-        if ( ls . type != END_OF_INPUT )
-            parserError ( LexicalSymbol ( END_OF_INPUT ), ls );
-        return 0;
-    }
-    if ( expected . front () . isTerminal ()  )
-        comparison ( ls );
-    else
-        expansion ( ls );
-    return 1;
+    std::size_t first = marks . back ();
+    marks . pop_back ();
+    return popChildren ( kind, head, first );
 }
 
-void mila::Parser::expansion ( const LexicalSymbol & ls )
+/// dropRoutine - A lazy parser forgets a routine nothing reachable calls,
+/// with its prototype and whatever was parsed of its body.
+bool mila::Parser::dropRoutine ( void )
 {
-    ( this ->* parseNonterm [ expected . front () . nonterminal ] ) ( ls );
+    if ( !lazy || reachable . count ( names . back () ) )
+        return false;
+    nodes . resize ( marks . back () - 1 );
+    marks . pop_back ();
+    names . pop_back ();
+    return true;
 }
 
-
-void mila::Parser::comparison ( const LexicalSymbol & ls )
+SymbolId mila::Parser::popName ( void )
 {
-    if ( ls != this -> expected . front () )
-    {
-std::cerr<<"comparison: "<<std::endl;
-        parserError ( expected . front () . terminal, ls );
-    }
-
-    this -> expected . pop_front ();
+    SymbolId name = names . back ();
+    names . pop_back ();
+    return name;
 }
 
-void mila::Parser::discard ( std::vector < LexicalSymbol > symbols )
+/// popNames - Push a leaf node for every name since the last mark.
+void mila::Parser::popNames ( NodeKind kind )
 {
-    LexicalSymbol ls;
-    for ( const auto & symbol : symbols )
-    {
-        lex >> ls;
-        if ( ls != symbol )
-            parserError ( symbol, ls );
-    }
+    for ( std::size_t i = marks . back () ; i < names . size () ; i ++ )
+        nodes . push_back ( ast . add ( kind, names [ i ] ) );
+    names . resize ( marks . back () );
+    marks . pop_back ();
 }
 
-std::vector<std::unique_ptr<ExprAST>> mila::Parser::getParameters ( void )
+int mila::Parser::popNumber ( void )
 {
-    std::vector <std::unique_ptr<ExprAST>> args;
-    discard ( { "(" } );
-    LexicalSymbol next;
-    while ( true )
-    {
-        auto argument = expression ();
-        args . push_back ( std::move ( argument ) );
-        next = getNextLS ();
-        if ( next == "," )
-            continue;
-        else if ( next == ")" )
-            break;
-        else
-            parserError ( "',' or ')'", peekNextLS () );
-    }
-    return args;
+    int number = numbers . back ();
+    numbers . pop_back ();
+    return number;
 }
 
-std::vector<std::string> mila::Parser::getParameterDefinitions ( void )
+NodeId mila::Parser::parseProgram ( void )
 {
-    std::vector<std::string> args;
-    discard ( { "(" } );
-    LexicalSymbol next = peekNextLS ();
-    while ( true )
-    {
-        if ( next == ")" )
-            break;
-        std::string name = readIdentifier ();
-        args . push_back ( name );
-        discard ( { ":", "integer" } );
-        next = getNextLS ();
-        if ( next != ";" && next != ")" )
-            parserError ( "';' or ')'", next );
-    }
-    return args;
+    if ( threads > 1 || lazy )
+        parseBodies ();
+    stack . assign ( 1, N ( PROGRAM ) );
+    run ();
+    NodeId program = popNode ();
+    // every name is checked before codegen sees any of them
+    std::string message;
+    for ( const std::string & error : resolve ( ast, program ) )
+        message += ( message . empty () ? "" : "\n" ) + error + '.';
+    if ( !message . empty () )
+        throw ParserException ( message );
+    return program;
 }
 
-std::unique_ptr <ExprAST> mila::Parser::createExpression ( std::vector <std::unique_ptr <ExprAST>> operands, std::vector <OperEnum> operators ) const
+/// run - The LL(1) driver. Nonterminals are expanded by the parse table on
+/// the next symbol, terminals are matched and actions run as they are popped,
+/// so nesting depth only grows the stacks.
+void mila::Parser::run ( void )
 {
-    while ( operands . size () != 1 )
+    while ( !stack . empty () )
     {
-        for ( unsigned i = 1 ; i < operands . size () ; i ++ )
+        LLSymbol top = stack . back ();
+        stack . pop_back ();
+        if ( top >= FIRST_ACTION )
+            action ( Action ( top - FIRST_ACTION ) );
+        else if ( top >= FIRST_NONTERMINAL )
         {
-            if ( i == operators . size () || getPrecedence ( operators [ i - 1 ] ) >= getPrecedence ( operators [ i ] ) )
-            {
-                operands [ i - 1 ] = make_unique <BinaryExprAST> ( operators [ i - 1 ], std::move ( operands [ i - 1 ] ), std::move ( operands [ i ] ) );
-                operators . erase ( operators . begin () + ( i - 1 ) );
-                operands . erase ( operands . begin () + i );
-                break;
-            }
+            Nonterminal nonterminal = Nonterminal ( top - FIRST_NONTERMINAL );
+            if ( nonterminal == LOCALS && spliceBody () )
+                continue;
+            const LexicalSymbol & next = peek ();
+            int r = parseTables . rules [ nonterminal ] [ next . kind ];
+            if ( r == NO_RULE )
+                parserError ( expecting [ nonterminal ], next );
+            const LLSymbol * push = parseTables . pushes [ r ];
+            stack . insert ( stack . end (), push, push + grammar [ r ] . length );
+        }
+        else
+        {
+            read ();
+            if ( !matches ( top, previous . kind ) )
+                parserError ( LexicalSymbol ( TokenKind ( top ) ), previous );
         }
     }
-
-    return std::move ( operands [ 0 ] );
 }
-//====================================================================================================================
-std::unique_ptr<ExprAST> mila::Parser::start ( const LexicalSymbol & ls )
+
+/// parseBodies - Lex everything, find the routine bodies, pick the wanted
+/// ones and parse them on the thread pool. The bodies are spliced in when
+/// the parse gets to them.
+void mila::Parser::parseBodies ( void )
 {
-    if ( ls != "program" )
+    tokens = lexParallel ( lex . input (), threads );
+    if ( tokens . empty () || tokens . back () . type == ERROR )
     {
-        parserError ( LexicalSymbol ( "program" ), ls );
+        // lex reports the error when the parse gets to it, all of the
+        // program is parsed then
+        tokens . clear ();
+        lazy = false;
+        return;
     }
-    std::string name = readIdentifier ();
-    discard ( { ";" } );
-
-    Builder.SetInsertPoint(mainBlock);
-
-    // Generate prototypes
-    PrototypeAST("printi",{"x"}).codegen();
-    PrototypeAST("writeln",{"x"}).codegen();
-    PrototypeAST("dec",{"x"}).codegen();
-    PrototypeAST("inc",{"x"}).codegen();
-    Builder.SetInsertPoint(mainBlock);
+    cursor = tokens . data ();
+    limit = cursor + tokens . size ();
+    std::size_t main;
+    for ( const Routine & routine : routineBodies ( tokens, main ) )
+        bodies . push_back ( Body { routine . name, routine . first, routine . last, true, nullptr } );
+    if ( lazy )
+        markReachable ( main );
+    if ( threads <= 1 )
+        return;
+
+    std::atomic < std::size_t > next ( 0 );
+    auto worker = [&] ()
+    {
+        for ( std::size_t i ; ( i = next ++ ) < bodies . size () ; )
+            if ( bodies [ i ] . wanted )
+                parseBody ( bodies [ i ] );
+    };
+    ConcurrentInterning concurrently;
+    std::vector < std::thread > pool;
+    for ( unsigned t = 1 ; t < threads && t < bodies . size () ; t ++ )
+        pool . emplace_back ( worker );
+    worker ();
+    for ( std::thread & t : pool )
+        t . join ();
+}
 
-    // My fun stuff
+/// parseBody - Parse the locals and the block of one body. A body with an
+/// error or one not ending where expected is left to the sequential parse,
+/// which then reports the error the usual way.
+void mila::Parser::parseBody ( Body & body ) const
+{
+    std::unique_ptr < Parser > parser ( new Parser ( tokens . data () + body . first, tokens . data () + body . last ) );
     try
     {
-        auto decl = declarations ();
-        decl -> codegen ();
-        //std::cerr << "Declarations OK" << std::endl;
-        auto bl = block ();
-        //bl -> print ();
-        Builder.SetInsertPoint(mainBlock);
-        bl -> codegen ();
-        //std::cerr << "Block OK" << std::endl;
-        discard ( { "." } );
-        //expect ({});
+        parser -> stack = { N ( BLOCK ), N ( LOCALS ) };
+        parser -> run ();
+        if ( parser -> cursor == parser -> limit )
+            body . parser = std::move ( parser );
     }
-    catch ( const char * e )
+    catch ( ... )
     {
-        std::cerr << e << std::endl;
-        exit (1);
-        return nullptr;
     }
-
-
-    // Create return
-    Builder.CreateRet(NumberExprAST(0).codegen());
-
-    // Write the code out
-    raw_ostream *out;
-    std::error_code EC;
-    out = new raw_fd_ostream(std::string("binary/")+name, EC, sys::fs::F_None);
-    WriteBitcodeToFile(TheModule.get(), *out);
-    delete out;
-
-    return nullptr;
 }
 
-std::unique_ptr<ExprAST> mila::Parser::ident ( void )
+/// markReachable - Walk the call graph from the main block. Routines it
+/// reaches are reachable and their bodies wanted, forward declarations
+/// included as they go by name.
+void mila::Parser::markReachable ( std::size_t main )
 {
-    std::string name = readIdentifier ();
-    LexicalSymbol next = peekNextLS ();
-    if ( next == "[" )
+    std::unordered_map < SymbolId, std::vector < std::size_t > > definitions;
+    for ( std::size_t i = 0 ; i < bodies . size () ; i ++ )
     {
-        discard ( { "[" } );
-        auto index = expression ();
-        discard ( { "]" } );
-        return make_unique <ArrayExprAST> ( name, std::move ( index ) );
+        bodies [ i ] . wanted = false;
+        definitions [ bodies [ i ] . name ] . push_back ( i );
     }
-    return make_unique <VariableExprAST> ( name );
-}
-
-std::unique_ptr<ExprAST> mila::Parser::ident ( const LexicalSymbol & ls )
-{
-    lex << ls;
-    expect ({});
-    if ( ls . type == IDENTIFIER )
+    std::vector < SymbolId > work;
+    calls ( tokens, main, tokens . size (), work );
+    while ( !work . empty () )
     {
-        std::string name = readIdentifier ();
-        LexicalSymbol next = peekNextLS ();
-        if ( next == "[" )
+        SymbolId name = work . back ();
+        work . pop_back ();
+        if ( !reachable . insert ( name ) . second )
+            continue;
+        auto found = definitions . find ( name );
+        if ( found == definitions . end () )
+            continue;
+        for ( std::size_t i : found -> second )
         {
-            discard ( { "[" } );
-            auto index = expression ();
-            discard ( { "]" } );
-            return make_unique <ArrayExprAST> ( name, std::move ( index ) );
+            bodies [ i ] . wanted = true;
+            calls ( tokens, bodies [ i ] . first, bodies [ i ] . last, work );
         }
-        return make_unique <VariableExprAST> ( name );
     }
-    else
-        parserError ( LexicalSymbol ( IDENTIFIER ), ls );
-    return nullptr;
 }
 
-std::unique_ptr<ExprAST> mila::Parser::expression ( void )
+/// spliceBody - Called in place of expanding LOCALS. If a body starting at
+/// the next symbol was parsed already, its nodes are appended and LOCALS and
+/// the BLOCK below it are done. A body nobody wants is skipped unparsed, as
+/// long as the ';' after it is where expected.
+bool mila::Parser::spliceBody ( void )
 {
-    std::vector <std::unique_ptr <ExprAST>> operands;
-    std::vector <OperEnum> operators;
-    LexicalSymbol next;
-    do
+    if ( bodies . empty () )
+        return false;
+    std::size_t at = cursor - tokens . data ();
+    while ( nextBody < bodies . size () && bodies [ nextBody ] . first < at )
+        nextBody ++;
+    if ( nextBody == bodies . size () || bodies [ nextBody ] . first != at )
+        return false;
+    Body & body = bodies [ nextBody ];
+    if ( !body . wanted )
     {
-        next = peekNextLS ();
-        if ( next . type == INTEGER || next == "-" )
-        {
-            auto expr = make_unique <NumberExprAST> ( readNumber () );
-            operands . push_back ( std::move ( expr ) );
-        }
-        else if ( next . type == IDENTIFIER )
-        {
-            std::string name = readIdentifier ();
-            next = peekNextLS ();
-            if ( next == "[" )
-            {
-                discard ( { "[" } );
-                auto index = expression ();
-                discard ( { "]" } );
-                auto expr = make_unique <ArrayExprAST> ( name, std::move ( index ) );
-                operands . push_back ( std::move ( expr ) );
-            }
-            else if ( next == "(" )
-            {
-                std::vector <std::unique_ptr<ExprAST>> args;
-                args = getParameters ();
-                auto expr = make_unique <CallExprAST> ( name, std::move ( args ) );
-                operands . push_back ( std::move ( expr ) );
-            }
-            else
-            {
-                auto expr = make_unique <VariableExprAST> ( name );
-                operands . push_back ( std::move ( expr ) );
-            }
-        }
-        else if ( next == "(" )
-        {
-            discard ( { "(" } );
-            auto expr = expression ();
-            discard ( { ")" } );
-            operands . push_back ( std::move ( expr ) );
-        }
-        else
-            parserError ( "Number, identifier or '('", next );
-
-        next = peekNextLS ();
-        if ( LexicalSet { "+", "-", "*", "div", "mod", "=", "<", ">", "<=", ">=", "<>", "and", "or" } . count ( next ) )
-        {
-            if ( next == "+" )
-                operators . push_back ( ADD );
-            if ( next == "-" )
-                operators . push_back ( SUB );
-            if ( next == "*" )
-                operators . push_back ( MULT );
-            if ( next == "div" )
-                operators . push_back ( DIV );
-            if ( next == "mod" )
-                operators . push_back ( MOD );
-            if ( next == "=" )
-                operators . push_back ( EQ );
-            if ( next == "<" )
-                operators . push_back ( LT );
-            if ( next == ">" )
-                operators . push_back ( GT );
-            if ( next == "<=" )
-                operators . push_back ( LE );
-            if ( next == ">=" )
-                operators . push_back ( GE );
-            if ( next == "<>" )
-                operators . push_back ( NE );
-            if ( next == "and" )
-                operators . push_back ( AND );
-            if ( next == "or" )
-                operators . push_back ( OR );
-            getNextLS ();
-            continue;
-        }
-        else if ( LexicalSet { ";", ":=", ")", "]", "then", "do", "else", "end", ",", "to", "downto" } . count ( next ) )
-            break;
+        if ( body . last == tokens . size () || tokens [ body . last ] . kind != OP_SEMICOLON )
+            return false;
+        nextBody ++;
+        stack . pop_back ();
+        cursor = tokens . data () + body . last;
+        previous = cursor [ -1 ];
+        return true;
     }
-    while ( true );
-
-    return createExpression ( std::move ( operands ), operators );
+    if ( !body . parser )
+        return false;
+    nextBody ++;
+    NodeId base = ast . append ( body . parser -> ast );
+    for ( NodeId node : body . parser -> nodes )
+        nodes . push_back ( base + node );
+    stack . pop_back ();
+    cursor = tokens . data () + body . last;
+    previous = cursor [ -1 ];
+    body . parser . reset ();
+    return true;
 }
 
-std::unique_ptr<ExprAST> mila::Parser::expression ( const LexicalSymbol & ls )
+void mila::Parser::parse ( const char * executable )
 {
-    std::unique_ptr<ExprAST>foo;
-    lex << ls;
-    LexicalSymbol next;
-    do
+    try
     {
-        next = peekNextLS ();
-        if ( next . type == INTEGER || next == "-" )
-        {
-            auto expr = make_unique <NumberExprAST> ( readNumber () );
-        }
-        else if ( next . type == IDENTIFIER )
-        {
-            std::string name = readIdentifier ();
-            next = peekNextLS ();
-            if ( next == "[" )
-            {
-                discard ( { "[" } );
-                auto index = expression ();
-                discard ( { "]" } );
-                auto expr = make_unique <ArrayExprAST> ( name, std::move ( index ) );
-            }
-            else if ( next == "(" )
-            {
-                std::vector <std::unique_ptr<ExprAST>> args;
-                args = getParameters ();
-                auto expr = make_unique <CallExprAST> ( name, std::move ( args ) );
-            }
-            else
-            {
-                auto expr = make_unique <VariableExprAST> ( name );
-            }
-        }
-        else if ( next == "(" )
+        NodeId program = parseProgram ();
+        if ( folding )
+            fold ( ast );
+        codegen ( ast, program );
+        optimize ( level );
+
+        std::string file = std::string ( "binary/" ) + symbolName ( ast . name ( program ) );
+        if ( executable )
         {
-            discard ( { "(" } );
-            auto expr = expression ();
-            discard ( { ")" } );
+            // Object code straight from the module, no bitcode to read back
+            emitObject ( file + ".o", level );
+            linkExecutable ( file + ".o", executable );
         }
         else
-            parserError ( "Number, identifier or '('", next );
-
-        next = peekNextLS ();
-        if ( LexicalSet { "+", "-", "*", "div", "mod", "=", "<", ">", "<=", ">=", "<>", "and", "or" } . count ( next ) )
-        {
-            getNextLS ();
-            continue;
-        }
-        else if ( LexicalSet { ";", ":=", ")", "]", "then", "do", "else", "end", ",", "to", "downto" } . count ( next ) )
         {
-            expect ({});
-            return nullptr;
+            // Write the code out
+            raw_ostream *out;
+            std::error_code EC;
+            out = new raw_fd_ostream(file, EC, FILE_NONE);
+#if LLVM_VERSION_MAJOR >= 7
+            WriteBitcodeToFile(*TheModule, *out);
+#else
+            WriteBitcodeToFile(TheModule.get(), *out);
+#endif
+            delete out;
         }
     }
-    while ( true );
-
-    return nullptr;
-}
-
-std::unique_ptr<ExprAST> mila::Parser::declarations ()
-{
-    LexicalSymbol next = getNextLS ();
-    std::vector <std::unique_ptr <ExprAST>> decl;
-    while ( true )
+    catch ( const char * e )
     {
-        if ( next == "var" )
-        {
-            auto varDecl = variable ( next );
-            decl . push_back ( std::move ( varDecl ) );
-        }
-        else if ( next == "const" )
-        {
-            auto constDecl = constant ( next );
-            decl . push_back ( std::move ( constDecl ) );
-        }
-        else if ( next == "function" )
-        {
-            auto funcDecl = function ( next );
-            decl . push_back ( std::move ( funcDecl ) );
-        }
-        else if ( next == "procedure" )
-        {
-            auto procDecl = procedure ( next );
-            decl . push_back ( std::move ( procDecl ) );
-        }
-        else  if ( next == "begin" )
-        {
-            lex << next;
-            return make_unique <ExprListAST> ( std::move ( decl ) );
-        }
-        else
-            parserError ( "Declarations or 'begin'", next );
-        lex >> next;
+        std::cerr << e << std::endl;
+        exit (1);
     }
-    return nullptr;
+    // The whole tree goes at once
+    ast . clear ();
 }
 
-std::unique_ptr<ExprAST> mila::Parser::block ()
+const Ast & mila::Parser::tree ( void ) const
 {
-    discard ( { "begin" } );
-    std::vector <std::unique_ptr<ExprAST>> body;
-    LexicalSymbol next;
-    while ( true )
-    {
-        next = peekNextLS ();
-        if ( LexicalSet { "readln", "writeln", "write", "exit", "dec", "inc" } . count ( next ) || next . type == IDENTIFIER )
-        {
-            auto comm = command ();
-            body . push_back ( std::move ( comm ) );
-        }
-        else if ( LexicalSet { "if", "for", "while" } . count ( next ) )
-        {
-            auto contr = control ();
-            body . push_back ( std::move ( contr ) );
-        }
-        else
-            parserError ( "Statement or 'end'", next );
-
-        next = getNextLS ();
-        if ( next == ";" )
-            next = getNextLS ();
+    return ast;
+}
 
-        if ( LexicalSet { "readln", "writeln", "write", "exit", "dec", "inc", "if", "for", "while" } . count ( next ) || next . type == IDENTIFIER )
-            lex << next;
-        else if ( next == "end" )
-            break;
-        else
-            parserError ( "Statement or 'end'", next );
-    }
-    return make_unique <ExprListAST> ( std::move ( body ) );
+Ast & mila::Parser::tree ( void )
+{
+    return ast;
 }
 
-std::unique_ptr<ExprAST> mila::Parser::block ( const LexicalSymbol & ls )
+/// reduce - Replace the topmost operator and its two operands by one node.
+void mila::Parser::reduce ( void )
 {
-    expect ( { "begin", STATEMENT, "end" } );
-    parseSymbol ( ls );
-    return nullptr;
+    NodeId rhs = popNode ();
+    NodeId lhs = popNode ();
+    nodes . push_back ( ast . binary ( operators . back (), lhs, rhs ) );
+    operators . pop_back ();
 }
 
-std::unique_ptr<ExprAST> mila::Parser::variable ( const LexicalSymbol & ls )
+void mila::Parser::action ( Action a )
 {
-    if ( ls != "var" )
-        parserError ( LexicalSymbol ( "var" ), ls );
-    std::vector<std::string> names;
-    std::vector<std::unique_ptr<ExprAST>> decl;
-    LexicalSymbol next;
-    do
+    switch ( a )
     {
-        do
+        case A_NAME:
+            names . push_back ( previous . name );
+            break;
+        case A_NUMBER:
+            numbers . push_back ( previous . value );
+            break;
+        case A_NEGATE:
+            numbers . back () = - numbers . back ();
+            break;
+        case A_MARK:
+            marks . push_back ( nodes . size () );
+            break;
+        case A_MARK_NAMES:
+            marks . push_back ( names . size () );
+            break;
+        case A_LIST:
+            nodes . push_back ( popList ( NODE_LIST, 0 ) );
+            break;
+        case A_DECLARE:
+            popNames ( NODE_DECLARE );
+            break;
+        case A_DECLARE_ARRAY:
+        {
+            int hi = popNumber ();
+            int lo = popNumber ();
+            for ( std::size_t i = marks . back () ; i < names . size () ; i ++ )
+                nodes . push_back ( ast . add ( NODE_DECLARE, names [ i ], { ast . number ( -lo ), ast . number ( hi - lo + 1 ) } ) );
+            names . resize ( marks . back () );
+            marks . pop_back ();
+            break;
+        }
+        case A_CONSTANT:
+        {
+            NodeId val = ast . number ( popNumber () );
+            nodes . push_back ( ast . add ( NODE_CONST, popName (), { val } ) );
+            break;
+        }
+        case A_PROTOTYPE:
+        {
+            // the name stays for the body
+            std::size_t first = nodes . size ();
+            popNames ( NODE_VARIABLE );
+            nodes . push_back ( popChildren ( NODE_PROTOTYPE, names . back (), first ) );
+            break;
+        }
+        case A_FORWARD:
+            if ( lazy && !reachable . count ( names . back () ) )
+                nodes . pop_back ();
+            names . pop_back ();
+            break;
+        case A_FUNCTION:
         {
-            std::string name = readIdentifier ();
-            names . push_back ( name );
-            lex >> next;
-            if ( next == ":" )
+            if ( dropRoutine () )
                 break;
-            if ( next != "," )
-                parserError ( "':' or ','", next );
+            // add name to the mix of arguments/variables, the prototype
+            // right below the mark is the first child
+            NodeId block = popNode ();
+            SymbolId name = popName ();
+            nodes . push_back ( ast . add ( NODE_DECLARE, name ) );
+            nodes . push_back ( block );
+            nodes . push_back ( ast . add ( NODE_VARIABLE, name ) );
+            std::size_t first = marks . back () - 1;
+            marks . pop_back ();
+            nodes . push_back ( popChildren ( NODE_FUNCTION, 0, first ) );
+            break;
         }
-        while ( true );
-
-        lex >> next;
-        if ( next == "integer" )
+        case A_PROCEDURE:
         {
-            for ( std::string & name : names )
-                decl . push_back ( make_unique <DeclareExprAST> ( name ) );
+            if ( dropRoutine () )
+                break;
+            popName ();
+            nodes . push_back ( ast . number (0) );
+            std::size_t first = marks . back () - 1;
+            marks . pop_back ();
+            nodes . push_back ( popChildren ( NODE_FUNCTION, 0, first ) );
+            break;
         }
-        else if ( next == "array" )
+        case A_LITERAL:
+            nodes . push_back ( ast . number ( popNumber () ) );
+            break;
+        case A_ZERO:
+            nodes . push_back ( ast . number (0) );
+            break;
+        case A_VARIABLE:
+            nodes . push_back ( ast . add ( NODE_VARIABLE, popName () ) );
+            break;
+        case A_INDEX:
         {
-            discard ( { "[" } );
-            int lo = readNumber ();
-            discard ( { ".." } );
-            int hi = readNumber ();
-            discard ( { "]", "of", "integer" } );
-
-            for ( std::string & name : names )
-                decl . push_back ( make_unique <DeclareExprAST> ( name, -lo, hi - lo + 1 ) );
+            NodeId index = popNode ();
+            nodes . push_back ( ast . add ( NODE_ARRAY, popName (), { index } ) );
+            break;
         }
-        else
-            parserError ( "'integer' or 'array'", next );
-
-        names . clear ();
-
-        discard ( { ";" } );
-        lex >> next;
-
-        if ( next == "var" || next == "const" || next == "function" || next == "procedure" || next == "begin" )
+        case A_CALL:
+            nodes . push_back ( popList ( NODE_CALL, popName () ) );
+            break;
+        case A_ASSIGN:
         {
-            lex << next;
+            NodeId expr = popNode ();
+            NodeId var = popNode ();
+            nodes . push_back ( ast . binary ( ASSIGN, var, expr ) );
             break;
         }
-        else if ( next . type == IDENTIFIER )
+        case A_LIBRARY:
         {
-            lex << next;
-            continue;
+            NodeId arg = ast . add ( NODE_VARIABLE, popName () );
+            nodes . push_back ( ast . add ( NODE_LIBRARY, popName (), { arg } ) );
+            break;
         }
-        parserError ( "'var', 'const', 'function', 'procedure', 'begin' or identifier", next );
-    }
-    while ( true );
-
-    return make_unique <ExprListAST> ( std::move ( decl ) );
-}
-
-std::unique_ptr<ExprAST> mila::Parser::constant ( const LexicalSymbol & ls )
-{
-    if ( ls != "const" )
-        parserError ( LexicalSymbol ( "const" ), ls );
-    std::vector<std::unique_ptr<ExprAST>> decl;
-    LexicalSymbol next;
-    do
-    {
-        std::string name = readIdentifier ();
-        discard ( { "=" } );
-        int val = readNumber ();
-        discard ( { ";" } );
-        decl . push_back ( make_unique <ConstExprAST> ( name, val ) );
-
-        next = peekNextLS ();
-        if ( next == "var" || next == "const" || next == "function" || next == "procedure" || next == "begin" )
+        case A_RETURN:
+            nodes . push_back ( ast . add ( NODE_RETURN, 0 ) );
             break;
-        else if ( next . type == IDENTIFIER )
-            continue;
-        parserError ( "'var', 'const', 'function', 'procedure', 'begin' or identifier", next );
-    }
-    while ( true );
-
-    return make_unique <ExprListAST> ( std::move ( decl ) );
-}
-
-std::unique_ptr<ExprAST> mila::Parser::constant2 ( const LexicalSymbol & ls )
-{
-    return nullptr;
-}
-
-std::unique_ptr<ExprAST> mila::Parser::function ( const LexicalSymbol & ls )
-{
-    if ( ls != "function" )
-        parserError ( LexicalSymbol ( "function" ), ls );
-    std::string name = readIdentifier ();
-    std::vector <std::string> args;
-    args = getParameterDefinitions ();
-    discard ( { ":", "integer", ";" } );
-    auto proto = make_unique <PrototypeAST> ( name, std::move ( args ) );
-    // add name to the mix of arguments/variables
-    LexicalSymbol next = peekNextLS ();
-    if ( next == "forward" )
-    {
-        discard ( { "forward", ";" } );
-        return proto;
-    }
-    std::vector <std::unique_ptr<ExprAST>> body;
-    while ( next == "var" )
-    {
-        auto decl = variable ( getNextLS () );
-        body . push_back ( std::move ( decl ) );
-        next = peekNextLS ();
-    }
-    auto def = block ();
-    discard ( { ";" } );
-    body . push_back ( make_unique <DeclareExprAST> ( name ) );
-    body . push_back ( std::move ( def ) );
-    body . push_back ( make_unique <VariableExprAST> ( name ) );
-    //auto bodyAST = make_unique <ExprListAST> ( std::move ( body ) );
-    return make_unique <FunctionAST> ( std::move ( proto ), std::move ( body ) );
-}
-
-std::unique_ptr<ExprAST> mila::Parser::procedure ( const LexicalSymbol & ls )
-{
-    if ( ls != "procedure" )
-        parserError ( LexicalSymbol ( "procedure" ), ls );
-    std::string name = readIdentifier ();
-    std::vector <std::string> args;
-    args = getParameterDefinitions ();
-    discard ( { ";" } );
-    auto proto = make_unique <PrototypeAST> ( name, std::move ( args ) );
-    // DO NOT add name to the mix of arguments/variables
-    // but return something probably either way just in case
-    LexicalSymbol next = peekNextLS ();
-    if ( next == "forward" )
-    {
-        discard ( { "forward", ";" } );
-        return proto;
-    }
-    std::vector <std::unique_ptr<ExprAST>> body;
-    while ( next == "var" )
-    {
-        // THE HELL IS HAPPENING HERE??
-        auto decl = variable ( getNextLS () );
-        body . push_back ( std::move ( decl ) );
-        next = peekNextLS ();
-    }
-    auto def = block ();
-    discard ( { ";" } );
-    body . push_back ( std::move ( def ) );
-    body . push_back ( make_unique <NumberExprAST> (0) );
-    //auto bodyAST = make_unique <ExprListAST> ( std::move ( body ) );
-    return make_unique <FunctionAST> ( std::move ( proto ), std::move ( body ) );
-}
-
-std::unique_ptr<ExprAST> mila::Parser::command ()
-{
-    LexicalSymbol ls = getNextLS ();
-    if ( ls == "write" )
-    {
-        discard ( { "(", "'" } );
-        while ( getNextLS () != "'" );
-        discard ( { ")" } );
-        return make_unique <NumberExprAST> (0);
-    }
-    if ( ls . type == IDENTIFIER || ( ls == "writeln" && peekNextLS () == "(" ) )
-    {
-        std::string name = ls . name;
-        LexicalSymbol next = peekNextLS ();
-        if ( next == "[" || next == ":=" )
+        case A_IF:
         {
-            std::unique_ptr <ExprAST> RHS;
-            if ( next == "[" )
-            {
-                discard ( { "[" } );
-                auto index = expression ();
-                discard ( { "]" } ); 
-                RHS = make_unique <ArrayExprAST> ( name, std::move ( index ) );
-            }
-            else
-            {
-                RHS = make_unique <VariableExprAST> ( name );
-            }
-            discard ( { ":=" } );
-            auto expr = expression ();
-            return make_unique <BinaryExprAST> ( ASSIGN, std::move ( RHS ), std::move ( expr ) );
+            NodeId els = popNode ();
+            NodeId then = popNode ();
+            NodeId cond = popNode ();
+            nodes . push_back ( ast . add ( NODE_IF, 0, { cond, then, els } ) );
+            break;
         }
-        else if ( next == "(" )
+        case A_STEP_UP:
+            nodes . push_back ( ast . number (1) );
+            break;
+        case A_STEP_DOWN:
+            nodes . push_back ( ast . number (-1) );
+            break;
+        case A_FOR:
         {
-            std::vector <std::unique_ptr<ExprAST>> args;
-            args = getParameters ();
-            return make_unique <CallExprAST> ( name, std::move ( args ) );
+            NodeId body = popNode ();
+            NodeId endVal = popNode ();
+            NodeId stepVal = popNode ();
+            NodeId startVal = popNode ();
+            nodes . push_back ( ast . add ( NODE_FOR, popName (), { startVal, endVal, stepVal, body } ) );
+            break;
         }
-        else
-            parserError ( "'[', '(' or ':='", next );
-    }
-    if ( LexicalSet { "readln", "inc", "dec" } . count ( ls ) )
-    {
-        discard ( { "(" } );
-        auto arg = readIdentifier ();
-        discard ( { ")" } );
-        return make_unique <LibraryExprAST> ( ls . name, arg );
-    }
-    else if ( ls == "exit" )
-        return make_unique <ReturnExprAST> ();
-    else
-        parserError ( "Command", ls );
-    return nullptr;
-}
-
-std::unique_ptr<ExprAST> mila::Parser::command ( const LexicalSymbol & ls )
-{
-    if ( ls == "write" )
-    {
-        expect ( { "write", "(", "'", FOO, "'", ")" } );
-        parseSymbol ( ls );
-        return nullptr;
-    }
-    expect ({});
-    if ( ls . type == IDENTIFIER || ( LexicalSet ( { "readln", "writeln", "dec", "inc" } ) . count ( ls ) && peekNextLS () == "(" ) )
-    {
-        std::string name = ls . name;
-        LexicalSymbol next = peekNextLS ();
-        if ( next == "[" || next == ":=" )
+        case A_WHILE:
         {
-            std::unique_ptr <ExprAST> RHS;
-            if ( next == "[" )
+            NodeId body = popNode ();
+            NodeId cond = popNode ();
+            nodes . push_back ( ast . add ( NODE_WHILE, 0, { cond, body } ) );
+            break;
+        }
+        case A_DIRECTIVES:
+            marks . push_back ( nodes . size () );
+            directives . emplace_back ();
+            break;
+        case A_DIRECTIVE:
+            if ( !direct ( directives . back (), previous ) )
             {
-                discard ( { "[" } );
-                auto index = expression ();
-                discard ( { "]" } ); 
-                RHS = make_unique <ArrayExprAST> ( name, std::move ( index ) );
+                std::stringstream error;
+                error << "Invalid directive \"" << previous << "\".";
+                throw ParserException ( error . str () );
             }
-            else
+            break;
+        case A_DIRECT:
+            // a lazy parse may have left the routine out
+            if ( nodes . size () > marks . back () )
             {
-                RHS = make_unique <VariableExprAST> ( name );
+                if ( misplaced ( ast . kind ( nodes . back () ), directives . back () ) )
+                    throw ParserException ( "Directive does not apply to what follows it." );
+                ast . direct ( nodes . back (), directives . back () );
             }
-            discard ( { ":=" } );
-            auto expr = expression ();
-            return make_unique <BinaryExprAST> ( ASSIGN, std::move ( RHS ), std::move ( expr ) );
-        }
-        else if ( next == "(" )
-        {
-            std::vector <std::unique_ptr<ExprAST>> args;
-            args = getParameters ();
-            return make_unique <CallExprAST> ( name, std::move ( args ) );
-        }
-        else
-            parserError ( "'[', '(' or ':='", next );
-    }
-    else if ( ls == "exit" )
-        return nullptr;
-    else
-        parserError ( "Command", ls );
-    return nullptr;
-}
-
-std::unique_ptr<ExprAST> mila::Parser::control ()
-{
-    auto next = getNextLS ();
-    if ( next == "if" )
-    {
-        auto cond = expression ();
-        discard ( { "then" } );
-        auto then = blockCommand ();
-        next = peekNextLS ();
-        std::unique_ptr <ExprAST> els;
-        if ( next == "else" )
+            marks . pop_back ();
+            directives . pop_back ();
+            break;
+        case A_EXPRESSION:
+            marks . push_back ( operators . size () );
+            break;
+        case A_OPERATOR:
         {
-            discard ( { "else" } );
-            els = blockCommand ();
+            // Higher getPrecedence binds tighter, equal precedence associates to the left.
+            OperEnum op = binaryOperator ( previous . kind );
+            while ( operators . size () > marks . back () && getPrecedence ( operators . back () ) >= getPrecedence ( op ) )
+                reduce ();
+            operators . push_back ( op );
+            break;
         }
-        else
+        case A_END_EXPRESSION:
+            while ( operators . size () > marks . back () )
+                reduce ();
+            marks . pop_back ();
+            break;
+        case A_PROGRAM:
         {
-            els = make_unique <NumberExprAST> ( 0 );
+            NodeId block = popNode ();
+            NodeId declarations = popNode ();
+            nodes . push_back ( ast . add ( NODE_PROGRAM, popName (), { declarations, block } ) );
+            break;
         }
-        return make_unique <IfExprAST> ( std::move ( cond ), std::move ( then ), std::move ( els ) );
-    }
-    else if ( next == "for" )
-    {
-        std::string var = readIdentifier ();
-        discard ( { ":=" } );
-        auto startVal = expression ();
-        next = getNextLS ();
-        int step;
-        if ( next == "to" )
-            step = 1;
-        else if ( next == "downto" )
-            step = -1;
-        else
-            parserError ( "'to' or 'downto'", next );
-        auto stepVal = make_unique <NumberExprAST> ( step );
-        auto endVal = expression ();
-        discard ( { "do" } );
-        auto then = blockCommand ();
-
-        return make_unique <ForExprAST> ( var, std::move ( startVal ), std::move ( endVal ), std::move ( stepVal ), std::move ( then ) );
-    }
-    else if ( next == "while" )
-    {
-        auto cond = expression ();
-        discard ( { "do" } );
-        auto body = blockCommand ();
-        return make_unique <WhileExprAST> ( std::move ( cond ), std::move ( body ) );
+        default:
+            break;
     }
-    else
-        parserError ( "'if', 'for' or 'while'", next );
-    return nullptr;
-}
-
-std::unique_ptr<ExprAST> mila::Parser::blockCommand ( void )
-{
-    LexicalSymbol next = peekNextLS ();
-    if ( next == "begin" )
-        return block ();
-    return command ();
 }
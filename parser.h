@@ -2,8 +2,10 @@
 #include "ast.h"
 #include <iostream>
 #include <string>
-#include <map>
-#include <list>
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+#include <memory>
 #include <unordered_set>
 
 #ifndef MILA_PARSER_H
@@ -20,128 +22,216 @@ namespace mila
             friend std::ostream & operator << ( std::ostream &, const ParserException & );
     };
 
-    enum LLType
+    /// Nonterminal - Nonterminals of the LL(1) grammar in parser.cpp.
+    enum Nonterminal
     {
-        TERMINAL,
-        NONTERMINAL,
+        PROGRAM,
+        DECLARATIONS,
+        DECLARATION,
+        ROUTINE,
+        VARIABLES,
+        VARIABLES_REST,
+        VARIABLE_GROUP,
+        NAMES_REST,
+        VARIABLE_TYPE,
+        NUMBER,
+        CONSTANTS,
+        CONSTANTS_REST,
+        CONSTANT,
+        PARAMETERS,
+        PARAMETER_LIST,
+        PARAMETER_REST,
+        PARAMETER,
+        FUNCTION_BODY,
+        PROCEDURE_BODY,
+        LOCALS,
+        BLOCK,
+        AFTER_STATEMENT,
+        NEXT_STATEMENT,
+        STATEMENT,
+        DIRECTIVES,
+        COMMAND,
+        TEXT,
+        ASSIGN_OR_CALL,
+        ARGUMENTS,
+        ARGUMENTS_REST,
+        CONTROL,
+        ELSE_PART,
+        DIRECTION,
+        BLOCK_COMMAND,
+        EXPRESSION,
+        EXPRESSION_REST,
+        BINARY_OPERATOR,
+        OPERAND,
+        OPERAND_SUFFIX,
+        NONTERM_CNT
     };
 
-    enum Nonterminal
+    /// Action - Semantic actions of the grammar. They run when they reach the
+    /// top of the parse stack and build the AST on the value stacks.
+    enum Action
     {
-        START,              // 0
-        IDENT,              // 1
-        ARRAY_OR_FUNCTION,  // 2
-        ARRAY_BOUNDS,       // 3
-        FUNCTION_PARAMS,    // 4
-        MINUS_NUMB,         // 5
-        NUMB,               // 6
-        VALUE,              // 7
-        POSITIVE_VALUE,     // 8
-        EXPRESSION,         // 9
-        EXPRESSION2,        // 10
-        OPERATION,          // 11
-        TYPE,               // 12
-        DECLARATIONS,       // 13
-        BLOCK,              // 14
-        VARIABLE,           // 15
-        VARIABLE2,          // 16
-        VARIABLE3,          // 17
-        CONSTANT,           // 18
-        CONSTANT2,          // 19
-        FUNCTION,           // 20
-        PROCEDURE,          // 21
-        PARAMETERS,         // 22
-        PARAMETERS2,        // 23
-        DEFINITION,         // 24
-        STATEMENT,          // 25
-        NEXT_STATEMENT,     // 26
-        NEXT_STATEMENT2,    // 27
-        COMMAND,            // 28
-        CONTROL,            // 29
-        BLOCK_OR_COMMAND,   // 30
-        IF_ELSE_IF,         // 31
-        IF_ELSE,            // 32
-        TO_DOWNTO,          // 33
-        PARAM,              // 34
-        PARAM2,             // 35
-        ASSIGN_OR_CALL,     // 36
-        FOO,                // 37
-        NONTERM_CNT
+        A_NAME,             // name of the symbol just read
+        A_NUMBER,           // value of the integer just read
+        A_NEGATE,
+        A_MARK,             // start of a node list
+        A_MARK_NAMES,       // start of a name list
+        A_LIST,
+        A_DECLARE,
+        A_DECLARE_ARRAY,
+        A_CONSTANT,
+        A_PROTOTYPE,
+        A_FORWARD,
+        A_FUNCTION,
+        A_PROCEDURE,
+        A_LITERAL,
+        A_ZERO,
+        A_VARIABLE,
+        A_INDEX,
+        A_CALL,
+        A_ASSIGN,
+        A_LIBRARY,
+        A_RETURN,
+        A_IF,
+        A_STEP_UP,
+        A_STEP_DOWN,
+        A_FOR,
+        A_WHILE,
+        A_DIRECTIVES,       // start of the directives before a statement or routine
+        A_DIRECTIVE,        // directive just read
+        A_DIRECT,           // attach them to the node it made
+        A_EXPRESSION,
+        A_OPERATOR,
+        A_END_EXPRESSION,
+        A_PROGRAM,
+        ACTION_CNT
     };
 
-    struct LLSymbol
+    /// LLSymbol - Parse stack entry. Token kinds come first, then the
+    /// nonterminals and then the actions, see parser.cpp.
+    typedef unsigned char LLSymbol;
+
+    /// TokenSet - Set of token kinds kept as one bit per TokenKind, used for
+    /// the FIRST and FOLLOW sets of the nonterminals.
+    class TokenSet
     {
-        LLSymbol ( const std::string & );
-        LLSymbol ( const char * );
-        LLSymbol ( const LexicalSymbol & );
-        LLSymbol ( Nonterminal );
-        bool isTerminal ( void ) const;
-        bool isNonterminal ( void ) const;
-        bool operator == ( const LLSymbol & ) const;
-        bool operator != ( const LLSymbol & ) const;
-        bool operator == ( const LexicalSymbol & ) const;
-        bool operator != ( const LexicalSymbol & ) const;
-        bool operator == ( const Nonterminal & ) const;
-        bool operator != ( const Nonterminal & ) const;
-        friend bool operator == ( const LexicalSymbol &, const LLSymbol & );
-        friend bool operator != ( const LexicalSymbol &, const LLSymbol & );
-        friend bool operator == ( const Nonterminal &, const LLSymbol & );
-        friend bool operator != ( const Nonterminal &, const LLSymbol & );
-        friend std::ostream & operator << ( std::ostream &, const LLSymbol & );
-        LLType type;
-        LexicalSymbol terminal;
-        Nonterminal nonterminal;
+        public:
+            constexpr TokenSet ( void ) : bits ( 0 ) {}
+            constexpr TokenSet ( std::initializer_list < TokenKind > kinds )
+            : bits ( 0 )
+            {
+                for ( TokenKind kind : kinds )
+                    bits |= std::uint64_t ( 1 ) << kind;
+            }
+            constexpr TokenSet operator | ( const TokenSet & other ) const
+            {
+                return TokenSet ( bits | other . bits );
+            }
+            constexpr TokenSet operator - ( const TokenSet & other ) const
+            {
+                return TokenSet ( bits & ~other . bits );
+            }
+            constexpr bool operator == ( const TokenSet & other ) const
+            {
+                return bits == other . bits;
+            }
+            constexpr bool operator != ( const TokenSet & other ) const
+            {
+                return bits != other . bits;
+            }
+            constexpr bool contains ( TokenKind kind ) const
+            {
+                return bits >> kind & 1;
+            }
+            bool contains ( const LexicalSymbol & ls ) const
+            {
+                return contains ( ls . kind );
+            }
+            static constexpr TokenSet all ( void )
+            {
+                return TokenSet ( ( std::uint64_t ( 1 ) << TOKEN_KIND_CNT ) - 1 );
+            }
+        private:
+            constexpr explicit TokenSet ( std::uint64_t bits ) : bits ( bits ) {}
+            std::uint64_t bits;
     };
+    static_assert ( TOKEN_KIND_CNT <= 64, "TokenSet holds at most 64 token kinds." );
 
-    class Parser;
-    typedef std::unique_ptr<ExprAST> ( expandType ) ( const LexicalSymbol & );
-    typedef std::unique_ptr<ExprAST> ( Parser::*expandPointer ) ( const LexicalSymbol & );
-    typedef std::unordered_set < LexicalSymbol > LexicalSet;
-    typedef std::list < LLSymbol > tokenList;
     class Parser
     {
         public:
-            Parser ( Lexan && lex );
-            int parseSymbol ( const LexicalSymbol & );
-            void printQue ( std::ostream & os = std::cerr ) const;
-            void parse ( void );
+            /// With more than one thread the whole input is lexed first and
+            /// function and procedure bodies are parsed on that many threads.
+            /// The tree is the same either way. A lazy parser leaves out the
+            /// routines the main block can not reach by calls, their bodies
+            /// are not even parsed. The code parse writes out is optimized
+            /// at level, 0 to 3 as with -O. Without folding parse leaves the
+            /// constant expressions to the generated code.
+            Parser ( Lexan && lex, unsigned threads = 1, bool lazy = false, unsigned level = 0, bool folding = true );
+            /// parse - Parse the program, generate and optimize its code and
+            /// write it out, as bitcode to binary/<program name>. Given an
+            /// executable the code goes to the object binary/<program
+            /// name>.o instead, linked with binary/inc.o into executable.
+            void parse ( const char * executable = nullptr );
+            /// parseProgram - Only build the tree, the root is returned.
+            NodeId parseProgram ( void );
+            const Ast & tree ( void ) const;
+            /// tree - The tree for passes to rewrite, as parse folds it.
+            Ast & tree ( void );
         private:
-            void discard ( std::vector < LexicalSymbol > symbols );
-            int readNumber ( void );
-            std::string readIdentifier ( void );
-            std::vector <std::unique_ptr <ExprAST>> getParameters ( void );
-            std::vector <std::string> getParameterDefinitions ( void );
-            std::unique_ptr <ExprAST> expression ( void );
-            std::unique_ptr <ExprAST> ident ( void );
-            std::unique_ptr <ExprAST> declarations ( void );
-            std::unique_ptr <ExprAST> command ( void );
-            std::unique_ptr <ExprAST> control ( void );
-            std::unique_ptr <ExprAST> block ( void );
-            std::unique_ptr <ExprAST> blockCommand ( void );
-            std::unique_ptr <ExprAST> createExpression ( std::vector <std::unique_ptr <ExprAST>> operands, std::vector <OperEnum> operators ) const;
-            void expansion ( const LexicalSymbol & );
-            void comparison ( const LexicalSymbol & );
-            LexicalSymbol getNextLS ( void );
-            LexicalSymbol peekNextLS ( void );
-            
-            expandType start;
-            expandType ident;
-            expandType expression;
-            expandType block;
-            expandType variable;
-            expandType constant;
-            expandType constant2;
-            expandType function;
-            expandType procedure;
-            expandType command;
-            
-            void expect ( tokenList && );
+            /// Body - Tokens [first, last) of the body of routine name found
+            /// before parsing, whether it is wanted in the tree and the parser
+            /// which parsed it if that succeeded.
+            struct Body
+            {
+                SymbolId name;
+                std::size_t first;
+                std::size_t last;
+                bool wanted;
+                std::unique_ptr < Parser > parser;
+            };
+
+            Parser ( const LexicalSymbol * first, const LexicalSymbol * last );
+            void run ( void );
+            const LexicalSymbol & peek ( void );
+            void read ( void );
+            void parseBodies ( void );
+            void parseBody ( Body & ) const;
+            void markReachable ( std::size_t main );
+            bool spliceBody ( void );
+            bool dropRoutine ( void );
+            void action ( Action );
+            void reduce ( void );
+            NodeId popNode ( void );
+            NodeId popChildren ( NodeKind kind, std::uint32_t head, std::size_t first );
+            NodeId popList ( NodeKind kind, std::uint32_t head );
+            void popNames ( NodeKind kind );
+            SymbolId popName ( void );
+            int popNumber ( void );
             void parserError ( const char *, const LexicalSymbol & ) const;
             void parserError ( const LexicalSymbol &, const LexicalSymbol & ) const;
-            std::map < std::string, int > constants;
-            std::map < std::string, int > variables;
-            tokenList expected;
-            expandPointer parseNonterm [ NONTERM_CNT ];
+
+            std::vector < LLSymbol > stack;
+            Ast ast;
+            std::vector < NodeId > nodes;
+            std::vector < SymbolId > names;
+            std::vector < int > numbers;
+            std::vector < OperEnum > operators;
+            std::vector < Directives > directives;
+            std::vector < std::size_t > marks;
+            LexicalSymbol previous;
+            unsigned threads;
+            bool lazy;
+            unsigned level;
+            bool folding;
+            std::unordered_set < SymbolId > reachable;
+            std::vector < LexicalSymbol > tokens;
+            /// Next and end of the symbols read instead of lex, both null when
+            /// reading from lex.
+            const LexicalSymbol * cursor;
+            const LexicalSymbol * limit;
+            std::vector < Body > bodies;
+            std::size_t nextBody;
             Lexan lex;
     };
 }
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Times the parser on programs made of one long expression, a sum of array
+# elements with a few products mixed in. Doubling the number of terms
+# should roughly double the time. Peak RSS comes from parser -s.
+
+mkdir -p binary
+for terms in 1000 2000 4000 8000 16000
+do
+file=$(mktemp)
+{
+echo "program longexpr;"
+echo "var a : array [0 .. 9] of integer; x : integer;"
+echo "begin"
+printf "    x := a[0]"
+for ((i = 1; i < terms; i++))
+do
+if ((i % 7 == 0))
+then
+printf " + a[%d] * %d" $((i % 10)) $i
+else
+printf " + a[%d]" $((i % 10))
+fi
+done
+echo ";"
+echo "    writeln(x);"
+echo "end."
+} > "$file"
+start=$(date +%s.%N)
+if ! stats=$(./parser -s < "$file" 2>&1 > /dev/null)
+then
+rm "$file"
+echo "parser failed on $terms terms" >&2
+exit 1
+fi
+end=$(date +%s.%N)
+rm "$file"
+awk -v t=$terms -v s=$start -v e=$end -v m="${stats##*$'\n'}" 'BEGIN { printf "%6d terms: %.3f s, %s\n", t, e - s, m }'
+done
@@ -1,17 +1,41 @@
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
 #include "parser.h"
 #include "lexan.h"
 
 using namespace mila;
 using namespace std;
 
-int main ( void )
+int main ( int argc, char ** argv )
 {
+    bool statistics = false;
+    unsigned jobs = 1;
+    bool lazy = false;
+    bool folding = true;
+    unsigned level = 0;
+    const char * executable = nullptr;
+    for ( int i = 1 ; i < argc ; i ++ )
+    {
+        if ( !strcmp ( argv [ i ], "-s" ) )
+            statistics = true;
+        else if ( !strcmp ( argv [ i ], "-j" ) && i + 1 < argc )
+            jobs = atoi ( argv [ ++ i ] );
+        else if ( !strcmp ( argv [ i ], "-l" ) )
+            lazy = true;
+        else if ( !strcmp ( argv [ i ], "-F" ) )
+            folding = false;
+        else if ( !strncmp ( argv [ i ], "-O", 2 ) )
+            level = atoi ( argv [ i ] + 2 );
+        else if ( !strcmp ( argv [ i ], "-o" ) && i + 1 < argc )
+            executable = argv [ ++ i ];
+    }
     try
     {
-        Parser parser ( Lexan ( move ( cin ) ) );
-        parser . parse ();
+        Parser parser ( Lexan ( move ( cin ) ), jobs, lazy, level, folding );
+        parser . parse ( executable );
         cerr << "Evertying parsed." << endl;
     }
     catch ( ParserException & e )
@@ -19,6 +43,11 @@ int main ( void )
         cerr << e << endl;
         return 1;
     }
+    if ( statistics )
+    {
+        struct rusage usage;
+        getrusage ( RUSAGE_SELF, &usage );
+        cerr << "peak RSS " << usage . ru_maxrss << " KB" << endl;
+    }
     return 0;
 }
-
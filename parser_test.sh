@@ -5,8 +5,16 @@
 #exit 2
 #fi
 
+# output executable - What executable prints for a fixed input, and how it
+# exits.
+output ()
+{
+for k in $(seq 100); do echo 2; echo 5; done | timeout 10 "$1" 2>&1
+echo "exit $?"
+}
+
 i=0
-for file in samples/*
+for file in samples/*.p
 do
 printf '%d: %s\n' $((++i)) "$file"
 if ! ./parser < "$file"
@@ -15,3 +23,114 @@ exit 1
 fi
 echo
 done
+
+# The samples in samples/errors have to be rejected with the message written
+# in the comment on their first line.
+for file in samples/errors/*.p
+do
+printf '%d: %s\n' $((++i)) "$file"
+expected=$(head -1 "$file" | sed 's/^{ *//; s/ *}$//')
+if ./parser < "$file" 2> tmp_error || [ "$(cat tmp_error)" != "$expected" ]
+then
+echo "expected: $expected"
+echo "read:     $(cat tmp_error)"
+rm tmp_error
+exit 1
+fi
+done
+rm -f tmp_error
+
+# The directives of samples/directives.p have to reach the bitcode as loop
+# metadata, branch weights and function attributes.
+printf '%d: samples/directives.p metadata\n' $((++i))
+./parser < samples/directives.p 2> /dev/null && llvm-dis binary/directives -o tmp_ir
+for expected in '"llvm.loop.vectorize.enable", i1 true' '"llvm.loop.unroll.count", i32 4' \
+    '"llvm.loop.vectorize.width", i32 4' '"llvm.loop.unroll.disable"' '"llvm.loop.vectorize.enable", i1 false' \
+    '"branch_weights", i32 1, i32 2000' '"branch_weights", i32 2000, i32 1'
+do
+if ! grep -qF "$expected" tmp_ir
+then
+echo "missing: $expected"
+rm -f tmp_ir
+exit 1
+fi
+done
+if ! grep -B1 'define i32 @square' tmp_ir | grep -q alwaysinline || ! grep -B1 'define i32 @show' tmp_ir | grep -q noinline
+then
+echo "missing: alwaysinline on square, noinline on show"
+rm -f tmp_ir
+exit 1
+fi
+rm -f tmp_ir
+
+# Folding must not change what a program does. The samples and the ones in
+# samples/fold are built with and without it (-F), linked with binary/inc.o,
+# and both have to print the same for the same input.
+for file in samples/*.p samples/fold/*.p
+do
+printf '%d: %s folded and unfolded\n' $((++i)) "$file"
+if ! ./parser -o binary/folded < "$file" 2> /dev/null || ! ./parser -F -o binary/unfolded < "$file" 2> /dev/null
+then
+echo "build failed"
+exit 1
+fi
+if [ "$(output binary/folded)" != "$(output binary/unfolded)" ]
+then
+diff <(output binary/folded) <(output binary/unfolded)
+exit 1
+fi
+done
+
+# Bodies parsed on threads give the tree of the sequential parse, so -j 4 has
+# to write the same bitcode byte for byte.
+for file in samples/*.p
+do
+printf '%d: %s with -j 4\n' $((++i)) "$file"
+name=$(sed -n 's/^ *program *\([A-Za-z0-9_]*\).*/\1/p' "$file" | head -1)
+if ! ./parser < "$file" 2> /dev/null || ! mv binary/"$name" tmp_sequential \
+    || ! ./parser -j 4 < "$file" 2> /dev/null || ! cmp tmp_sequential binary/"$name"
+then
+rm -f tmp_sequential
+exit 1
+fi
+done
+rm -f tmp_sequential
+
+# A lazy parse leaves out only what the main block can not reach, the
+# programs built with -l have to do what the full ones do.
+for file in samples/*.p
+do
+printf '%d: %s with -l\n' $((++i)) "$file"
+if ! ./parser -o binary/full < "$file" 2> /dev/null || ! ./parser -l -o binary/lazy < "$file" 2> /dev/null
+then
+echo "build failed"
+exit 1
+fi
+if [ "$(output binary/full)" != "$(output binary/lazy)" ]
+then
+diff <(output binary/full) <(output binary/lazy)
+exit 1
+fi
+done
+
+# samples/lazyRoutines.p reaches a forward declared function and the one
+# calling it back only through each other, unused is never called.
+printf '%d: samples/lazyRoutines.p routines kept with -l\n' $((++i))
+./parser -l < samples/lazyRoutines.p 2> /dev/null && llvm-dis binary/lazyRoutines -o tmp_ir
+if [ "$(sed -n 's/^define i32 @\([a-z]*\).*/\1/p' tmp_ir | sort | tr '\n' ' ')" != "down main report up " ]
+then
+echo "expected down main report up, read: $(sed -n 's/^define i32 @\([a-z]*\).*/\1/p' tmp_ir | sort | tr '\n' ' ')"
+rm -f tmp_ir
+exit 1
+fi
+rm -f tmp_ir
+
+# After a for loop which runs to the end the variable holds end, and start
+# after an empty one. samples/forValue.p prints it after each kind of loop.
+printf '%d: samples/forValue.p variable after the loops\n' $((++i))
+if ! ./parser -o binary/forValue < samples/forValue.p 2> /dev/null \
+    || [ "$(output binary/forValue | tr '\n' ' ')" != "1 2 3 3 3 2 1 1 5 exit 0 " ]
+then
+echo "expected 1 2 3 3 3 2 1 1 5 exit 0, read: $(output binary/forValue | tr '\n' ' ')"
+exit 1
+fi
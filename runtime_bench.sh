@@ -0,0 +1,63 @@
+#!/bin/bash
+# Times the programs samples/sortBubble.p, isprime.p and factorization.p
+# compile to at -O0 to -O3, scaled up so they run for a while: sortBubble
+# sorts 10000 numbers, the main blocks of the other two call their routine
+# for every number below 10^7 and 10^5. An argument multiplies the sizes.
+# The parser emits the object and links it with binary/inc.o as generate.sh
+# does.
+
+factor=${1:-1}
+mkdir -p binary
+
+# scaled sample size statement - The sample with 20 replaced by size, or with
+# a main block running statement for every k below size.
+scaled ()
+{
+if [ "$1" = sortBubble ]
+then
+sed "s/\b20\b/$2/g" samples/$1.p
+return
+fi
+main=$(grep -n '^begin' samples/$1.p | tail -1 | cut -d: -f1)
+head -n $((main - 1)) samples/$1.p
+echo "var k, s : integer;"
+echo "begin"
+echo "    s := 0;"
+echo "    k := 0;"
+echo "    while k < $2 do"
+echo "    begin"
+echo "        $3;"
+echo "        k := k + 1"
+echo "    end;"
+echo "    writeln(s)"
+echo "end."
+}
+
+printf "%-14s %10s %9s %9s %9s %9s %8s\n" program size -O0 -O1 -O2 -O3 speedup
+for sample in "sortBubble $((10000 * factor))" "isprime $((10000000 * factor)) s := s + isprime(k)" \
+    "factorization $((100000 * factor)) factorization(k)"
+do
+set -- $sample
+name=$1
+size=$2
+shift 2
+file=$(mktemp)
+scaled $name $size "$*" > "$file"
+times=()
+for level in 0 1 2 3
+do
+if ! ./parser -O$level -o binary/$name.O$level < "$file" 2> /dev/null
+then
+echo "$name failed to compile at -O$level" >&2
+rm "$file"
+continue 2
+fi
+start=$(date +%s.%N)
+binary/$name.O$level > /dev/null
+end=$(date +%s.%N)
+times+=($(awk -v s=$start -v e=$end 'BEGIN { print e - s }'))
+done
+rm "$file"
+awk -v n=$name -v z=$size -v t0=${times[0]} -v t1=${times[1]} -v t2=${times[2]} -v t3=${times[3]} \
+    'BEGIN { printf "%-14s %10d %9.3f %9.3f %9.3f %9.3f %7.1fx\n", n, z, t0, t1, t2, t3, t0 / t3 }'
+done
@@ -0,0 +1,38 @@
+program directives;
+
+{$inline}
+function square(x: integer): integer;
+begin
+    square := x * x
+end;
+
+{$noinline}
+procedure show(x: integer);
+begin
+    writeln(x)
+end;
+
+var i, s : integer;
+    v : array [0 .. 99] of integer;
+begin
+    {$vectorize}
+    for i := 0 to 99 do
+        v[i] := square(i);
+    s := 0;
+    {$unroll 4} {$vectorize 4}
+    for i := 0 to 99 do
+        s := s + v[i];
+    {$unlikely}
+    if s < 0 then
+        show(0)
+    else
+        show(s);
+    i := 0;
+    {$unroll 1}
+    {$vectorize 1}
+    while i < 10 do
+        inc(i);
+    {$likely}
+    if i = 10 then
+        show(i)
+end.
@@ -0,0 +1,16 @@
+{ Wrong number of arguments to gcd in the main block. }
+program argumentCount;
+
+function gcd(a: integer; b: integer): integer;
+begin
+    while b <> 0 do begin
+        gcd := b;
+        b := a mod b;
+        a := gcd;
+    end;
+    gcd := a;
+end;
+
+begin
+    writeln(gcd(12));
+end.
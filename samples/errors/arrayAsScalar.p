@@ -0,0 +1,8 @@
+{ Array used as a scalar X in the main block. }
+program arrayAsScalar;
+
+var X : array [0 .. 9] of integer;
+begin
+    X[0] := 1;
+    writeln(X);
+end.
@@ -0,0 +1,7 @@
+{ Assignment to constant limit in the main block. }
+program constantAssignment;
+
+const limit = 10;
+begin
+    limit := 20;
+end.
@@ -0,0 +1,8 @@
+{ Redeclared name n in the main block. }
+program duplicateDeclaration;
+
+var n : integer;
+var n : integer;
+begin
+    n := 1;
+end.
@@ -0,0 +1,5 @@
+{ Expected "Statement or 'end'", read "KEYWORD - end". }
+program emptyBlock;
+
+begin
+end.
@@ -0,0 +1,11 @@
+{ Expected "identifier", read "OPERATOR - )". }
+program noParameters;
+
+function one(): integer;
+begin
+    one := 1
+end;
+
+begin
+    writeln(one())
+end.
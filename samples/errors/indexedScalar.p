@@ -0,0 +1,9 @@
+{ Indexed non-array N in the main block. }
+program indexedScalar;
+
+var N : integer;
+begin
+    N := 1;
+    N[0] := 2;
+    writeln(N);
+end.
@@ -0,0 +1,10 @@
+{ Directive does not apply to what follows it. }
+program misplacedDirective;
+
+var i : integer;
+begin
+    i := 0;
+    {$unroll 4}
+    if i < 10 then
+        writeln(i)
+end.
@@ -0,0 +1,9 @@
+{ Expected "KEYWORD - then", read "KEYWORD - do". }
+program missingThen;
+
+var x : integer;
+begin
+    x := 1;
+    if x > 0 do
+        writeln(x)
+end.
@@ -0,0 +1,11 @@
+{ Expected "Statement or 'end'", read "KEYWORD - else". }
+program semicolonElse;
+
+var x : integer;
+begin
+    x := 1;
+    if x > 0 then
+        writeln(x);
+    else
+        writeln(0)
+end.
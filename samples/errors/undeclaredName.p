@@ -0,0 +1,8 @@
+{ Undeclared name m in the main block. }
+program undeclaredName;
+
+var n : integer;
+begin
+    n := 1;
+    m := n + 1;
+end.
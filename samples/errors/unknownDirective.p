@@ -0,0 +1,9 @@
+{ Invalid directive "DIRECTIVE - parallel". }
+program unknownDirective;
+
+var i : integer;
+begin
+    {$parallel}
+    for i := 0 to 9 do
+        writeln(i)
+end.
@@ -0,0 +1,27 @@
+program negativeDivision;
+
+const a = -7; b = 2; c = -2; big = 2147483647;
+
+var n : integer;
+begin
+    writeln(a div b);
+    writeln(a mod b);
+    writeln(7 div c);
+    writeln(7 mod c);
+    writeln(a div c);
+    writeln(a mod c);
+    writeln(-8 div 4 * 3 - 10 mod -3);
+    writeln(big + 1);
+    writeln(big * 2);
+    writeln((a < b) + (a = c) + (b <> c));
+    writeln((a < b) and (c < b));
+    writeln(1 or 2);
+    if (a div b) < -3 then
+        writeln(1)
+    else
+        writeln(0);
+    n := 3;
+    while a > b do
+        n := 0;
+    writeln(n);
+end.
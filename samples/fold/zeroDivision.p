@@ -0,0 +1,9 @@
+program zeroDivision;
+
+const zero = 0;
+
+begin
+    writeln(1);
+    writeln(7 div zero);
+    writeln(2);
+end.
@@ -0,0 +1,14 @@
+program forAssign;
+
+var
+    i: integer;
+begin
+    for i := 1 to 10 do begin
+        writeln(i);
+        i := i + 5;
+    end;
+    for i := 10 downto 1 do begin
+        writeln(i);
+        i := i - 4;
+    end;
+end.
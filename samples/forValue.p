@@ -0,0 +1,15 @@
+program forValue;
+
+var
+    i: integer;
+begin
+    for i := 1 to 3 do
+        writeln(i);
+    writeln(i);
+    for i := 3 downto 1 do
+        writeln(i);
+    writeln(i);
+    for i := 5 to 4 do
+        writeln(i);
+    writeln(i);
+end.
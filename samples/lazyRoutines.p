@@ -0,0 +1,34 @@
+program lazyRoutines;
+
+function down(n: integer): integer; forward;
+
+function up(n: integer): integer;
+begin
+    if n > 0 then
+        up := down(n - 1) + 1
+    else
+        up := 0;
+end;
+
+function down(n: integer): integer;
+begin
+    if n > 0 then
+        down := up(n - 1) + 2
+    else
+        down := 0;
+end;
+
+function unused(n: integer): integer;
+begin
+    unused := n * n;
+end;
+
+procedure report(n: integer);
+begin
+    writeln(n);
+end;
+
+begin
+    report(up(5));
+    report(down(5));
+end.